@@ -0,0 +1,63 @@
+#!/usr/bin/env bash
+# Parses, runs and frees pathologically deep ASTs of growing size.
+#
+#   bench/deep_ast.sh [path/to/npavc] [max_terms]
+#
+# Three shapes are generated per size: a left-deep `x + x + ... + x` chain,
+# fully nested parentheses `((...(1)...))` and a nested call chain
+# `id(id(...id(1)...))`. Time and peak memory should grow linearly with the
+# term count; a crash here means something is recursing on the C++ stack.
+
+set -euo pipefail
+
+NPAVC=${1:-./npavc}
+MAX_TERMS=${2:-1000000}
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+generate() {
+    local shape=$1 terms=$2
+    awk -v shape="$shape" -v n="$terms" 'BEGIN {
+        if (shape == "id") print "int id(int a) { return a + 0; }";
+        print "void main() {";
+        print "    int x = 1;";
+        printf "    printa(";
+        if (shape == "chain") {
+            printf "x";
+            for (i = 1; i < n; i++) printf " + x";
+        } else if (shape == "parens") {
+            for (i = 0; i < n; i++) printf "(";
+            printf "1";
+            for (i = 0; i < n; i++) printf ")";
+        } else {
+            for (i = 0; i < n; i++) printf "id(";
+            printf "1";
+            for (i = 0; i < n; i++) printf ")";
+        }
+        print ");";
+        print "}";
+    }'
+}
+
+measure() {
+    local file=$1
+    if [ -x /usr/bin/time ]; then
+        /usr/bin/time -f "%e s  %M KB" "$NPAVC" "$file" 2>&1 >/dev/null | tail -n 1
+    else
+        local start end
+        start=$(date +%s.%N)
+        "$NPAVC" "$file" >/dev/null
+        end=$(date +%s.%N)
+        awk -v s="$start" -v e="$end" 'BEGIN { printf "%.2f s\n", e - s }'
+    fi
+}
+
+printf "%-8s %10s  %s\n" "shape" "terms" "result"
+terms=1000
+while [ "$terms" -le "$MAX_TERMS" ]; do
+    for shape in chain parens id; do
+        generate "$shape" "$terms" > "$WORK/$shape.npav"
+        printf "%-8s %10d  %s\n" "$shape" "$terms" "$(measure "$WORK/$shape.npav")"
+    done
+    terms=$((terms * 10))
+done
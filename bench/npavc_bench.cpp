@@ -0,0 +1,324 @@
+// npavc_bench - throughput of the npavc lexer, parser, evaluator and code
+// generator on synthetic programs, plus `npavc -c` end-to-end latency.
+//
+//   npavc_bench [--scale <x>] [--repeat <n>] [--filter <text>] [--json] [--no-gxx]
+//
+// Every workload is generated in memory at a size multiplied by --scale and
+// each benchmark is repeated --repeat times; the fastest and median runs are
+// reported. --json prints one object per benchmark for regression tracking.
+//
+// Interpreted "ops" are AST nodes executed: the nodes outside loops once,
+// plus each while loop's condition and body once per iteration.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "npavc_core.h"
+
+namespace {
+
+// Swallows program output so the print benchmark measures the interpreter,
+// not the terminal
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int ch) override { return ch; }
+    std::streamsize xsputn(const char*, std::streamsize count) override { return count; }
+};
+
+NullBuffer nullBuffer;
+std::ostream nullStream(&nullBuffer);
+
+struct Workload {
+    std::string name;
+    std::string source;
+    long long loopIterations = 0;  // how often the program's while loop runs
+};
+
+// printa(x + (x * a - (x % b - (x / 1 + (x + ...))))) with `terms` operands,
+// each parenthesis nested inside the previous one, so the expression is
+// terms - 1 levels deep. Operand i cycles through x, x * (i % 9 + 1),
+// x % (i % 5 + 2) and x / 1.
+Workload deepExpression(long long terms) {
+    std::ostringstream src;
+    src << "void main() {\n    int x = 5;\n    printa(x";
+    for (long long i = 1; i < terms; i++) {
+        switch (i % 4) {
+            case 0: src << " + (x"; break;
+            case 1: src << " + (x * " << (i % 9 + 1); break;
+            case 2: src << " - (x % " << (i % 5 + 2); break;
+            case 3: src << " - (x / 1"; break;
+        }
+    }
+    src << std::string(static_cast<size_t>(terms - 1), ')') << ");\n}\n";
+    return {"deep_expression", src.str()};
+}
+
+// One declaration and one if/assignment per line, all in main()
+Workload statementList(long long statements) {
+    std::ostringstream src;
+    src << "void main() {\n    int v0 = 1;\n";
+    for (long long i = 1; i < statements; i++) {
+        if (i % 2) {
+            src << "    int v" << i << " = v" << i - 1 << " * 3 + " << i % 7 << ";\n";
+        } else {
+            src << "    int v" << i << " = 0;\n";
+            src << "    if (v" << i - 1 << " > 100) { v" << i << " = v" << i - 1 << " % 100; }"
+                << " else { v" << i << " = v" << i - 1 << " + 1; }\n";
+        }
+    }
+    src << "    printa(v" << statements - 1 << ");\n}\n";
+    return {"statement_list", src.str()};
+}
+
+// A tight counting while loop doing a little arithmetic per iteration
+Workload whileLoop(long long iterations) {
+    std::ostringstream src;
+    src << "void main() {\n"
+        << "    int i = 0;\n"
+        << "    int sum = 0;\n"
+        << "    while (i < " << iterations << ") {\n"
+        << "        sum = sum + i % 7 * 3;\n"
+        << "        i = i + 1;\n"
+        << "    }\n"
+        << "    printa(sum);\n"
+        << "}\n";
+    return {"while_loop", src.str(), iterations};
+}
+
+// A loop printing one number and one string per iteration
+Workload printHeavy(long long lines) {
+    std::ostringstream src;
+    src << "void main() {\n"
+        << "    int i = 0;\n"
+        << "    while (i < " << lines << ") {\n"
+        << "        printa(i);\n"
+        << "        printa(\" line\\n\");\n"
+        << "        i = i + 1;\n"
+        << "    }\n"
+        << "}\n";
+    return {"print_heavy", src.str(), lines};
+}
+
+// Counts the nodes of a subtree without recursing; with loopIterations set,
+// while loops count once per iteration
+long long countNodes(ASTNode* root, long long loopIterations = 1) {
+    long long count = 0;
+    std::vector<std::pair<ASTNode*, long long>> pending{{root, 1}};
+    while (!pending.empty()) {
+        auto [node, weight] = pending.back();
+        pending.pop_back();
+        count += weight;
+        long long childWeight = node->type == WHILE_NODE ? weight * loopIterations : weight;
+        for (ASTNode* child : node->children) {
+            if (child) pending.push_back({child, childWeight});
+        }
+    }
+    return count;
+}
+
+struct Result {
+    std::string name;
+    std::string workload;
+    std::string unit;
+    long long items = 0;  // units processed per run
+    std::vector<double> seconds;
+
+    double best() const { return *std::min_element(seconds.begin(), seconds.end()); }
+
+    double median() const {
+        std::vector<double> sorted = seconds;
+        std::sort(sorted.begin(), sorted.end());
+        return sorted[sorted.size() / 2];
+    }
+};
+
+struct Options {
+    double scale = 1.0;
+    int repeat = 5;
+    std::string filter;
+    bool json = false;
+    bool gxx = true;
+};
+
+// Times body() `repeat` times. setup() runs untimed before each run.
+Result measure(const std::string& name, const Workload& workload, const std::string& unit,
+               const Options& options, const std::function<void()>& setup,
+               const std::function<long long()>& body) {
+    Result result{name, workload.name, unit, 0, {}};
+    for (int run = 0; run < options.repeat; run++) {
+        setup();
+        auto begin = std::chrono::steady_clock::now();
+        result.items = body();
+        auto end = std::chrono::steady_clock::now();
+        result.seconds.push_back(std::chrono::duration<double>(end - begin).count());
+    }
+    return result;
+}
+
+std::vector<Token> lex(const std::string& source) {
+    Lexer lexer(source, nullStream);
+    return lexer.tokenize();
+}
+
+ASTNode* parse(const std::vector<Token>& tokens) {
+    Parser parser(tokens);
+    ASTNode* program = parser.parse();
+    Optimizer optimizer;
+    optimizer.optimize(program);
+    return program;
+}
+
+void runWorkload(const Workload& workload, const Options& options, std::vector<Result>& results) {
+    auto selected = [&](const std::string& benchmark) {
+        return options.filter.empty() ||
+               (benchmark + "/" + workload.name).find(options.filter) != std::string::npos;
+    };
+    std::vector<Token> tokens = lex(workload.source);
+    ASTNode* program = parse(tokens);
+    // Counted up front so the timed runs only do the work being measured
+    long long nodes = countNodes(program);
+    long long ops = countNodes(program, std::max(workload.loopIterations, 1LL));
+    auto reparse = [&]() {
+        delete program;
+        program = parse(tokens);
+    };
+    auto noSetup = []() {};
+
+    if (selected("lex")) {
+        results.push_back(measure("lex", workload, "tokens", options, noSetup, [&]() {
+            return static_cast<long long>(lex(workload.source).size());
+        }));
+    }
+    if (selected("parse")) {
+        results.push_back(measure("parse", workload, "nodes", options, noSetup, [&]() {
+            Parser parser(tokens);
+            delete parser.parse();
+            return nodes;
+        }));
+    }
+    if (selected("eval")) {
+        results.push_back(measure("eval", workload, "ops", options, reparse, [&]() {
+            Evaluator evaluator;
+            evaluator.setOutput(nullStream, nullStream);
+            evaluator.evaluate(program);
+            return ops;
+        }));
+    }
+    if (selected("codegen")) {
+        results.push_back(measure("codegen", workload, "nodes", options, reparse, [&]() {
+            Evaluator evaluator;
+            evaluator.generateCppCode(program);
+            return nodes;
+        }));
+    }
+    delete program;
+}
+
+// `npavc -c` from source text to a linked executable, g++ included
+void runCompileLatency(const Options& options, std::vector<Result>& results) {
+    Workload workload = statementList(200);
+    // Generated C++ prints with print(); printa() only exists in the interpreter
+    size_t call = workload.source.find("printa(");
+    workload.source.replace(call, 7, "print(");
+    if (!options.filter.empty() && ("compile/" + workload.name).find(options.filter) == std::string::npos) {
+        return;
+    }
+    namespace fs = std::filesystem;
+    fs::path dir = fs::temp_directory_path() / "npavc_bench";
+    fs::create_directories(dir);
+    std::string filename = (dir / "bench.npav").string();
+    std::string outputName = (dir / "bench").string();
+
+    RunOptions runOptions;
+    results.push_back(measure("compile", workload, "programs", options, []() {}, [&]() {
+        if (compileProgram(filename, workload.source, outputName, runOptions, nullStream, std::cerr) != 0) {
+            throw std::runtime_error("npavc -c failed");
+        }
+        return 1LL;
+    }));
+    fs::remove_all(dir);
+}
+
+void printText(const std::vector<Result>& results) {
+    std::printf("%-28s %12s %12s %16s\n", "benchmark", "best (ms)", "median (ms)", "throughput");
+    for (const Result& result : results) {
+        std::string name = result.name + "/" + result.workload;
+        double rate = result.items / result.best();
+        std::printf("%-28s %12.3f %12.3f %10.3g %s/s\n", name.c_str(), result.best() * 1e3,
+                    result.median() * 1e3, rate, result.unit.c_str());
+    }
+}
+
+void printJson(const std::vector<Result>& results, const Options& options) {
+    std::printf("{\n  \"scale\": %g,\n  \"repeat\": %d,\n  \"benchmarks\": [\n", options.scale, options.repeat);
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& result = results[i];
+        std::printf("    {\"name\": \"%s/%s\", \"unit\": \"%s\", \"items\": %lld, "
+                    "\"best_ns\": %.0f, \"median_ns\": %.0f, \"items_per_second\": %.6g}%s\n",
+                    result.name.c_str(), result.workload.c_str(), result.unit.c_str(), result.items,
+                    result.best() * 1e9, result.median() * 1e9, result.items / result.best(),
+                    i + 1 < results.size() ? "," : "");
+    }
+    std::printf("  ]\n}\n");
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--scale" && i + 1 < argc) {
+            options.scale = std::stod(argv[++i]);
+        } else if (arg == "--repeat" && i + 1 < argc) {
+            options.repeat = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--filter" && i + 1 < argc) {
+            options.filter = argv[++i];
+        } else if (arg == "--json") {
+            options.json = true;
+        } else if (arg == "--no-gxx") {
+            options.gxx = false;
+        } else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--scale <x>] [--repeat <n>] [--filter <text>] [--json] [--no-gxx]" << std::endl;
+            return 1;
+        }
+    }
+
+    auto scaled = [&](long long size) {
+        return std::max(1LL, static_cast<long long>(size * options.scale));
+    };
+    std::vector<Workload> workloads = {
+        deepExpression(scaled(10000)),
+        statementList(scaled(20000)),
+        whileLoop(scaled(1000000)),
+        printHeavy(scaled(200000)),
+    };
+
+    std::vector<Result> results;
+    try {
+        for (const Workload& workload : workloads) {
+            runWorkload(workload, options, results);
+        }
+        if (options.gxx) {
+            runCompileLatency(options, results);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    if (options.json) {
+        printJson(results, options);
+    } else {
+        printText(results);
+    }
+    return 0;
+}
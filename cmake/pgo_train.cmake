@@ -0,0 +1,50 @@
+# PGO training run, invoked by the npavc_pgo_train target:
+#   cmake -DNPAVC=... -DTRAINING=... -DWORK_DIR=... -DPROFILE_DIR=...
+#         [-DLLVM_PROFDATA=... -DCLANG_PROFILE=...] -P pgo_train.cmake
+#
+# The interpreter only knows printa() while generated C++ uses print(), so
+# the training program is run twice: a printa() copy through the
+# interpreter, and the original through -c (lexer, parser and code
+# generator; the g++ step isn't profiled).
+
+file(REMOVE_RECURSE "${WORK_DIR}")
+file(MAKE_DIRECTORY "${WORK_DIR}" "${PROFILE_DIR}")
+
+file(READ "${TRAINING}" source)
+string(REPLACE "print(" "printa(" interpreted "${source}")
+file(WRITE "${WORK_DIR}/interpret.npav" "${interpreted}")
+file(WRITE "${WORK_DIR}/compile.npav" "${source}")
+
+execute_process(
+    COMMAND "${NPAVC}" interpret.npav
+    WORKING_DIRECTORY "${WORK_DIR}"
+    OUTPUT_QUIET
+    RESULT_VARIABLE result
+)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "npavc failed to interpret the training program (exit ${result})")
+endif()
+
+execute_process(
+    COMMAND "${NPAVC}" compile.npav -c -o compiled
+    WORKING_DIRECTORY "${WORK_DIR}"
+    OUTPUT_QUIET
+    RESULT_VARIABLE result
+)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "npavc failed to compile the training program (exit ${result})")
+endif()
+
+# Clang writes raw profiles that have to be merged before -fprofile-use
+if(LLVM_PROFDATA)
+    file(GLOB raw_profiles "${PROFILE_DIR}/*.profraw")
+    execute_process(
+        COMMAND "${LLVM_PROFDATA}" merge -output=${CLANG_PROFILE} ${raw_profiles}
+        RESULT_VARIABLE result
+    )
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "llvm-profdata merge failed (exit ${result})")
+    endif()
+endif()
+
+message(STATUS "PGO profile written to ${PROFILE_DIR}")
@@ -3,6 +3,8 @@
 #include <QtWidgets/QVBoxLayout>
 #include <QtWidgets/QHBoxLayout>
 #include <QtWidgets/QTextEdit>
+#include <QtWidgets/QPlainTextEdit>
+#include <QtWidgets/QScrollBar>
 #include <QtWidgets/QLineEdit>
 #include <QtWidgets/QPushButton>
 #include <QtWidgets/QLabel>
@@ -12,16 +14,55 @@
 #include <QtWidgets/QFrame>
 #include <QtWidgets/QGroupBox>
 #include <QtWidgets/QStatusBar>
+#include <QtWidgets/QTreeView>
+#include <QtWidgets/QTableView>
+#include <QtWidgets/QHeaderView>
+#include <QtWidgets/QFileDialog>
+#include <QtWidgets/QToolTip>
 #include <QtCore/QProcess>
 #include <QtCore/QTimer>
 #include <QtCore/QDir>
 #include <QtGui/QFont>
+#include <QtGui/QFontMetrics>
 #include <QtGui/QPixmap>
 #include <QtGui/QPainter>
 #include <QtGui/QTextCursor>
+#include <QtGui/QTextBlock>
+#include <QtGui/QTextLayout>
+#include <QtGui/QTextDocument>
 #include <QtGui/QKeyEvent>
 #include <QtCore/QStandardPaths>
+#include <QtCore/QThread>
+#include <QtCore/QFile>
+#include <QtCore/QStringDecoder>
+#include <QtCore/QSocketNotifier>
+#include <QtCore/QPointer>
+#include <QtCore/QAbstractItemModel>
+#include <QtCore/QElapsedTimer>
 #include <cmath>
+#include <cstdio>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <streambuf>
+#include <vector>
+#include "npavc_core.h"
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <stdlib.h>
+#endif
 
 class FlowchartWidget : public QWidget {
     Q_OBJECT
@@ -32,16 +73,85 @@ public:
         setStyleSheet("background-color: white; border: 1px solid #ccc;");
     }
 
+public slots:
+    // Live view of an npavc run: the running stage is highlighted and each
+    // finished one is annotated with what it measured
+    void runStarted(bool compile) {
+        hasRun = true;
+        running = true;
+        compiling = compile;
+        activeStage = NO_STAGE;
+        totalSeconds = 0;
+        tokens = 0;
+        nodes = 0;
+        for (StageStats &stats : stages) stats = StageStats();
+        update();
+    }
+    
+    void phaseStarted(const QString &name) {
+        activeStage = stageFor(name);
+        update();
+    }
+    
+    void phaseFinished(const QString &name, double wallSeconds, qint64 heapBytes,
+                       qulonglong tokenCount, qulonglong nodeCount) {
+        totalSeconds += wallSeconds;
+        tokens = tokenCount;
+        nodes = nodeCount;
+        int stage = stageFor(name);
+        if (stage != NO_STAGE) {
+            stages[stage].done = true;
+            stages[stage].seconds += wallSeconds;
+            if (heapBytes >= 0) stages[stage].heapBytes = qMax<qint64>(stages[stage].heapBytes, 0) + heapBytes;
+        }
+        activeStage = NO_STAGE;
+        update();
+    }
+    
+    void runFinished(int code) {
+        running = false;
+        exitCode = code;
+        activeStage = NO_STAGE;
+        update();
+    }
+
 protected:
+    // The diagram never changes on its own, so it is drawn once into a pixmap
+    // and repaints (scrolling, expose, other windows moving over it) only
+    // copy the damaged part back. Anything that changes between frames is
+    // drawn over the copy.
     void paintEvent(QPaintEvent *event) override {
+        qreal ratio = devicePixelRatioF();
+        if (cache.isNull() || cache.devicePixelRatio() != ratio) {
+            renderCache(ratio);
+        }
+        
         QPainter painter(this);
+        QRect damaged = event->rect();
+        QRectF source(damaged.topLeft() * ratio, damaged.size() * ratio);
+        painter.drawPixmap(QRectF(damaged), cache, source);
+        
+        if (hasRun) drawRunOverlay(painter);
+    }
+    
+    // The legend sits at the bottom, so the layout depends on the height
+    void resizeEvent(QResizeEvent *event) override {
+        cache = QPixmap();
+        QWidget::resizeEvent(event);
+    }
+
+private:
+    void renderCache(qreal ratio) {
+        cache = QPixmap(size() * ratio);
+        cache.setDevicePixelRatio(ratio);
+        cache.fill(Qt::transparent);
+        QPainter painter(&cache);
         painter.setRenderHint(QPainter::Antialiasing);
         
         // Draw flowchart for compiler process
         drawCompilerFlowchart(painter);
     }
-
-private:
+    
     void drawCompilerFlowchart(QPainter &painter) {
         // Colors
         QColor boxColor(135, 206, 235); // Sky blue
@@ -53,11 +163,11 @@ private:
         QFont textFont("Arial", 9);
         
         // Box dimensions
-        int boxWidth = 120;
-        int boxHeight = 60;
-        int spacing = 80;
-        int startX = 50;
-        int startY = 20;
+        int boxWidth = BOX_WIDTH;
+        int boxHeight = BOX_HEIGHT;
+        int spacing = SPACING;
+        int startX = START_X;
+        int startY = START_Y;
         
         // Helper function to draw rounded rectangle with text
         auto drawBox = [&](int x, int y, const QString &text, QColor color = QColor()) {
@@ -145,7 +255,511 @@ private:
         painter.drawRect(10, height() - 20, 15, 15);
         painter.drawText(30, height() - 8, "Execution");
     }
+    
+    // Stages of the diagram that a core phase maps to
+    enum Stage { LEXER, PARSER, AST, EVALUATOR, CODEGEN, BINARY, STAGE_COUNT, NO_STAGE = -1 };
+    
+    struct StageStats {
+        bool done = false;
+        double seconds = 0;
+        qint64 heapBytes = -1;
+    };
+    
+    static const int BOX_WIDTH = 120;
+    static const int BOX_HEIGHT = 60;
+    static const int SPACING = 80;
+    static const int START_X = 50;
+    static const int START_Y = 20;
+    
+    static int stageFor(const QString &phase) {
+        if (phase == "lex") return LEXER;
+        if (phase == "parse") return PARSER;
+        if (phase == "optimize") return AST;
+        if (phase == "evaluate") return EVALUATOR;
+        if (phase == "codegen") return CODEGEN;
+        if (phase == "g++") return BINARY;
+        return NO_STAGE;  // freeing the AST isn't on the diagram
+    }
+    
+    // Where drawCompilerFlowchart puts each stage's box
+    static QRect stageRect(int stage) {
+        int row1 = START_Y + 40 + SPACING;
+        int row2 = START_Y + 40 + SPACING * 2;
+        int column2 = START_X + BOX_WIDTH + 30;
+        int column3 = START_X + (BOX_WIDTH + 30) * 2;
+        switch (stage) {
+            case LEXER: return QRect(START_X, row1, BOX_WIDTH, BOX_HEIGHT);
+            case PARSER: return QRect(START_X, row2, BOX_WIDTH, BOX_HEIGHT);
+            case AST: return QRect(column2, row2, BOX_WIDTH, BOX_HEIGHT);
+            case EVALUATOR: return QRect(column2, row1, BOX_WIDTH, BOX_HEIGHT);
+            case CODEGEN: return QRect(column3, row2, BOX_WIDTH, BOX_HEIGHT);
+            default: return QRect(column3, row1, BOX_WIDTH, BOX_HEIGHT);
+        }
+    }
+    
+    static QString formatSeconds(double seconds) {
+        if (seconds < 1e-3) return QString("%1 us").arg(seconds * 1e6, 0, 'f', 0);
+        if (seconds < 1) return QString("%1 ms").arg(seconds * 1e3, 0, 'f', 1);
+        return QString("%1 s").arg(seconds, 0, 'f', 2);
+    }
+    
+    static QString formatBytes(qint64 bytes) {
+        if (bytes < (1 << 20)) return QString("%1 KB").arg(bytes / 1024.0, 0, 'f', 0);
+        return QString("%1 MB").arg(bytes / double(1 << 20), 0, 'f', 1);
+    }
+    
+    // The live part, drawn over the cached diagram on every paint
+    void drawRunOverlay(QPainter &painter) {
+        painter.setRenderHint(QPainter::Antialiasing);
+        QFont statsFont("Arial", 7);
+        QFontMetrics metrics(statsFont);
+        painter.setFont(statsFont);
+        
+        for (int stage = 0; stage < STAGE_COUNT; stage++) {
+            const StageStats &stats = stages[stage];
+            if (!stats.done) continue;
+            QStringList parts{formatSeconds(stats.seconds)};
+            if (stage == LEXER && tokens) parts << QString("%1 tokens").arg(tokens);
+            if (stage == PARSER && nodes) parts << QString("%1 nodes").arg(nodes);
+            if (stats.heapBytes > 0) parts << "+" + formatBytes(stats.heapBytes);
+            QRect strip = stageRect(stage).adjusted(4, BOX_HEIGHT - 15, -4, -2);
+            painter.setPen(QColor(0, 100, 0));
+            painter.drawText(strip, Qt::AlignCenter, metrics.elidedText(parts.join("  "), Qt::ElideRight, strip.width()));
+        }
+        
+        if (activeStage != NO_STAGE) {
+            painter.setPen(QPen(QColor(255, 140, 0), 3));
+            painter.setBrush(QColor(255, 215, 0, 60));
+            painter.drawRoundedRect(stageRect(activeStage).adjusted(-3, -3, 3, 3), 12, 12);
+        }
+        
+        QString summary;
+        if (running) {
+            summary = compiling ? "Compiling..." : "Interpreting...";
+        } else {
+            summary = QString("Last %1: %2, exit code %3")
+                      .arg(compiling ? "compile" : "run", formatSeconds(totalSeconds)).arg(exitCode);
+        }
+        if (tokens) summary += QString(", %1 tokens, %2 AST nodes").arg(tokens).arg(nodes);
+        painter.setPen(QColor(25, 25, 112));
+        painter.setFont(QFont("Arial", 9));
+        painter.drawText(QRect(0, 0, width() - 10, 20), Qt::AlignRight | Qt::AlignVCenter, summary);
+    }
+    
+    QPixmap cache;  // the static diagram at the current size and pixel ratio
+    
+    bool hasRun = false;
+    bool running = false;
+    bool compiling = false;
+    int exitCode = 0;
+    int activeStage = NO_STAGE;
+    double totalSeconds = 0;
+    qulonglong tokens = 0;
+    qulonglong nodes = 0;
+    StageStats stages[STAGE_COUNT];
+};
+
+// Stream buffer that collects npavc output and hands it to a callback in
+// batches. Output is batched up to a few KB (or until the program flushes)
+// so a chatty program doesn't post one event per line to the GUI thread.
+// Batches end at a line break where possible, but a batch is sent once it
+// is full even without one, so output that never ends a line still shows
+// up and nothing grows without bound. The sink gets the text without its
+// final line break and whether there was one.
+class LineStreamBuf : public std::streambuf {
+public:
+    using Sink = std::function<void(const QString &text, bool endsLine)>;
+    
+    explicit LineStreamBuf(Sink sink) : sink(std::move(sink)) {}
+    
+    // Hands over whatever is left, including an unterminated last line
+    void finish() {
+        sendAll();
+    }
+
+protected:
+    int overflow(int ch) override {
+        if (ch != traits_type::eof()) {
+            pending += static_cast<char>(ch);
+            if (pending.size() >= BATCH_SIZE) flushLines();
+        }
+        return ch;
+    }
+    
+    std::streamsize xsputn(const char *text, std::streamsize count) override {
+        pending.append(text, static_cast<size_t>(count));
+        if (pending.size() >= BATCH_SIZE) flushLines();
+        return count;
+    }
+    
+    int sync() override {
+        sendAll();
+        return 0;
+    }
+
+private:
+    static const size_t BATCH_SIZE = 4096;
+    
+    // Sends the complete lines, keeping a trailing partial line buffered
+    // unless the batch is full
+    void flushLines() {
+        if (pending.size() >= BATCH_SIZE) {
+            sendAll();
+            return;
+        }
+        size_t lastNewline = pending.rfind('\n');
+        if (lastNewline == std::string::npos) return;
+        sink(QString::fromStdString(pending.substr(0, lastNewline)), true);
+        pending.erase(0, lastNewline + 1);
+    }
+    
+    // Sends everything, except the start of a UTF-8 character cut off at
+    // the end, which waits for the rest of its bytes
+    void sendAll() {
+        size_t end = pending.size();
+        size_t lead = end;
+        while (lead > 0 && end - lead < 3 && (static_cast<unsigned char>(pending[lead - 1]) & 0xC0) == 0x80) {
+            lead--;
+        }
+        if (lead > 0 && static_cast<unsigned char>(pending[lead - 1]) >= 0xC0) {
+            unsigned char first = static_cast<unsigned char>(pending[lead - 1]);
+            size_t length = first >= 0xF0 ? 4 : first >= 0xE0 ? 3 : 2;
+            if (end - (lead - 1) < length) end = lead - 1;
+        }
+        if (end == 0) return;
+        bool endsLine = pending[end - 1] == '\n';
+        sink(QString::fromStdString(pending.substr(0, endsLine ? end - 1 : end)), endsLine);
+        pending.erase(0, end);
+    }
+    
+    Sink sink;
+    std::string pending;
+};
+
+// Runs npavc in-process on a worker thread, so a run costs a thread start
+// instead of a fork/exec of the command line compiler. Output and errors are
+// emitted as signals, which Qt queues over to the receiver's thread.
+class NpavcRunner : public QObject {
+    Q_OBJECT
+
+public:
+    NpavcRunner(QObject *parent = nullptr) : QObject(parent) {}
+    
+    ~NpavcRunner() override {
+        if (worker) {
+            cancelled = true;
+            worker->wait();
+            delete worker;
+        }
+    }
+    
+    bool isRunning() const { return worker != nullptr; }
+    
+    // Asks a running program to stop; it finishes with "Error: Interrupted".
+    // A g++ step already under way still runs to completion.
+    void stop() {
+        cancelled = true;
+    }
+    
+    // Interprets (or with compile set, compiles) source, which was read from filename
+    void start(const std::string &filename, const std::string &source, bool compile,
+               const std::string &outputName, RunOptions options) {
+        cancelled = false;
+        options.cancel = &cancelled;
+        worker = QThread::create([this, filename, source, compile, outputName, options]() {
+            LineStreamBuf outBuf([this](const QString &text, bool endsLine) {
+                emit output(endsLine ? text + '\n' : text);
+            });
+            LineStreamBuf errBuf([this](const QString &text, bool endsLine) {
+                emit error(endsLine ? text + '\n' : text);
+            });
+            std::ostream out(&outBuf);
+            std::ostream errors(&errBuf);
+            
+            // Every run is timed so the Process Flow tab can show it
+            TimeReport report;
+            report.phaseStarted = [this](const std::string &name) {
+                emit phaseStarted(QString::fromStdString(name));
+            };
+            report.phaseFinished = [this, &report](const TimeReport::PhaseTiming &timing) {
+                emit phaseFinished(QString::fromStdString(timing.name), timing.wallSeconds, timing.peakBytes,
+                                   report.tokens, report.nodes);
+            };
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+            // The GUI can't see its allocator's high point, so a phase gets
+            // the heap growth at its end instead of its peak
+            report.currentBytes = []() { return static_cast<long long>(mallinfo2().uordblks); };
+            report.peakBytes = report.currentBytes;
+#endif
+            RunOptions runOptions = options;
+            runOptions.timeReport = &report;
+            
+            if (compile) {
+                exitCode = compileProgram(filename, source, outputName, runOptions, out, errors);
+            } else {
+                out << "Interpreting file: " << filename << std::endl;
+                exitCode = runProgram(filename, source, runOptions, out, errors);
+            }
+            outBuf.finish();
+            errBuf.finish();
+        });
+        connect(worker, &QThread::finished, this, [this]() {
+            worker->deleteLater();
+            worker = nullptr;
+            emit finished(exitCode);
+        });
+        worker->start();
+    }
+
+signals:
+    void output(const QString &text);
+    void error(const QString &text);
+    // Pipeline progress; heapBytes is -1 when unknown, and the counts are 0
+    // until parsing is done
+    void phaseStarted(const QString &name);
+    void phaseFinished(const QString &name, double wallSeconds, qint64 heapBytes,
+                       qulonglong tokens, qulonglong nodes);
+    void finished(int exitCode);
+
+private:
+    QThread *worker = nullptr;
+    int exitCode = 0;
+    std::atomic<bool> cancelled{false};
+};
+
+#ifdef Q_OS_UNIX
+// A child process on a pseudo-terminal. Through a pipe, C stdio fully
+// buffers its output and a program's progress only shows up once it exits
+// or fills the buffer; on a terminal it is line buffered and arrives as it
+// is written. Input goes through the terminal's line discipline, so echo,
+// backspace, Ctrl+C and Ctrl+D behave as they do in a real shell.
+class PtyProcess : public QObject {
+    Q_OBJECT
+
+public:
+    PtyProcess(QObject *parent = nullptr) : QObject(parent) {}
+    
+    ~PtyProcess() override {
+        if (pid > 0) {
+            ::kill(-pid, SIGKILL);
+            ::waitpid(pid, nullptr, 0);
+        }
+        closeMaster();
+    }
+    
+    // Returns false, with errorString() set, when the program can't be run.
+    // Everything the child needs is prepared before the fork, since only
+    // async-signal-safe calls are allowed between fork and exec in a
+    // multithreaded process.
+    bool start(const QString &program, const QStringList &arguments, const QString &workingDirectory,
+               int columns, int rows) {
+        QString path = program.contains('/') ? program : QStandardPaths::findExecutable(program);
+        if (path.isEmpty()) {
+            error = "No such file or directory";
+            return false;
+        }
+        std::vector<QByteArray> argBytes{path.toLocal8Bit()};
+        for (const QString &argument : arguments) argBytes.push_back(argument.toLocal8Bit());
+        std::vector<char *> argv;
+        for (QByteArray &argument : argBytes) argv.push_back(argument.data());
+        argv.push_back(nullptr);
+        
+        // No escape sequences please, the view shows plain text
+        QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+        environment.insert("TERM", "dumb");
+        std::vector<QByteArray> envBytes;
+        for (const QString &variable : environment.toStringList()) envBytes.push_back(variable.toLocal8Bit());
+        std::vector<char *> envp;
+        for (QByteArray &variable : envBytes) envp.push_back(variable.data());
+        envp.push_back(nullptr);
+        
+        QByteArray directory = workingDirectory.toLocal8Bit();
+        
+        // Closed by a successful exec; otherwise the child writes errno to it.
+        // It and the terminal are close-on-exec from the moment they exist:
+        // an NpavcRunner thread may fork g++ at any time, and a copy of the
+        // master or of the pipe's write end in there would keep the terminal
+        // from seeing EOF/HUP and this start() waiting for the pipe's EOF.
+        int execPipe[2];
+        if (!openExecPipe(execPipe)) {
+            error = std::strerror(errno);
+            return false;
+        }
+        int slave = openTerminal();
+        if (slave < 0) {
+            error = std::strerror(errno);
+            closeMaster();
+            ::close(execPipe[0]);
+            ::close(execPipe[1]);
+            return false;
+        }
+        struct winsize size = {};
+        size.ws_col = static_cast<unsigned short>(columns);
+        size.ws_row = static_cast<unsigned short>(rows);
+        ::ioctl(slave, TIOCSWINSZ, &size);
+        
+        pid = ::fork();
+        if (pid == 0) {
+            // A session of its own with the terminal as its controlling one,
+            // so kill() can end the whole process group
+            ::setsid();
+            ::ioctl(slave, TIOCSCTTY, 0);
+            ::dup2(slave, STDIN_FILENO);
+            ::dup2(slave, STDOUT_FILENO);
+            ::dup2(slave, STDERR_FILENO);
+            if (::chdir(directory.constData()) == 0) {
+                ::execve(argv[0], argv.data(), envp.data());
+            }
+            int failure = errno;
+            ssize_t written = ::write(execPipe[1], &failure, sizeof failure);
+            (void)written;
+            ::_exit(127);
+        }
+        ::close(slave);
+        ::close(execPipe[1]);
+        if (pid < 0) {
+            error = std::strerror(errno);
+            ::close(execPipe[0]);
+            closeMaster();
+            return false;
+        }
+        
+        int failure = 0;
+        ssize_t received;
+        do {
+            received = ::read(execPipe[0], &failure, sizeof failure);
+        } while (received < 0 && errno == EINTR);
+        ::close(execPipe[0]);
+        if (received == sizeof failure) {
+            ::waitpid(pid, nullptr, 0);
+            pid = -1;
+            closeMaster();
+            error = std::strerror(failure);
+            return false;
+        }
+        
+        ::fcntl(master, F_SETFL, ::fcntl(master, F_GETFL) | O_NONBLOCK);
+        notifier = new QSocketNotifier(master, QSocketNotifier::Read, this);
+        connect(notifier, &QSocketNotifier::activated, this, &PtyProcess::readMaster);
+        return true;
+    }
+    
+    QString errorString() const { return error; }
+    
+    // Input for the child, as if typed. Writes that don't fit while the
+    // child isn't reading are dropped rather than blocking the GUI.
+    void write(const QByteArray &data) {
+        qsizetype offset = 0;
+        while (master >= 0 && offset < data.size()) {
+            ssize_t written = ::write(master, data.constData() + offset, data.size() - offset);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            offset += written;
+        }
+    }
+    
+    // The child leads its own session, so this ends anything it started too
+    void kill() {
+        if (pid > 0) ::kill(-pid, SIGKILL);
+    }
+
+signals:
+    void readyRead(const QByteArray &data);
+    void finished(int exitCode, bool crashed);
+
+private:
+    // macOS has neither pipe2() nor O_CLOEXEC for ptys, so there the flag is
+    // set straight after and a fork on another thread can still slip in
+    static bool openExecPipe(int fds[2]) {
+#ifdef Q_OS_MACOS
+        if (::pipe(fds) != 0) return false;
+        ::fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+        ::fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+        return true;
+#else
+        return ::pipe2(fds, O_CLOEXEC) == 0;
+#endif
+    }
+    
+    // Opens a new pseudo-terminal into master; returns its slave side, or -1
+    int openTerminal() {
+#ifdef Q_OS_MACOS
+        const int cloexec = 0;
+#else
+        const int cloexec = O_CLOEXEC;
+#endif
+        master = ::posix_openpt(O_RDWR | O_NOCTTY | cloexec);
+        if (master < 0) return -1;
+        char slaveName[128];
+        if (::grantpt(master) != 0 || ::unlockpt(master) != 0 ||
+            ::ptsname_r(master, slaveName, sizeof slaveName) != 0) {
+            return -1;
+        }
+        int slave = ::open(slaveName, O_RDWR | O_NOCTTY | cloexec);
+#ifdef Q_OS_MACOS
+        ::fcntl(master, F_SETFD, FD_CLOEXEC);
+        if (slave >= 0) ::fcntl(slave, F_SETFD, FD_CLOEXEC);
+#endif
+        return slave;
+    }
+    
+    void readMaster() {
+        QByteArray data;
+        char buffer[4096];
+        bool closed = false;
+        for (;;) {
+            ssize_t received = ::read(master, buffer, sizeof buffer);
+            if (received > 0) {
+                data.append(buffer, received);
+                if (data.size() >= (1 << 16)) break;  // let the event loop breathe
+                continue;
+            }
+            if (received < 0 && errno == EINTR) continue;
+            // EAGAIN: drained for now. EOF or (on Linux) EIO: everything on
+            // the terminal has exited or closed it.
+            closed = received == 0 || errno != EAGAIN;
+            break;
+        }
+        if (!data.isEmpty()) emit readyRead(data);
+        if (closed) {
+            notifier->setEnabled(false);
+            reap();
+        }
+    }
+    
+    // The terminal can close a moment before the child can be waited for
+    void reap() {
+        int status = 0;
+        pid_t done = ::waitpid(pid, &status, WNOHANG);
+        if (done == 0) {
+            QTimer::singleShot(20, this, &PtyProcess::reap);
+            return;
+        }
+        pid = -1;
+        closeMaster();
+        if (done > 0 && WIFEXITED(status)) {
+            emit finished(WEXITSTATUS(status), false);
+        } else {
+            emit finished(-1, true);
+        }
+    }
+    
+    void closeMaster() {
+        // May run inside the notifier's own signal
+        if (notifier) notifier->deleteLater();
+        notifier = nullptr;
+        if (master >= 0) ::close(master);
+        master = -1;
+    }
+    
+    pid_t pid = -1;
+    int master = -1;
+    QSocketNotifier *notifier = nullptr;
+    QString error;
 };
+#endif
 
 class ShellEmulator : public QWidget {
     Q_OBJECT
@@ -153,7 +767,6 @@ class ShellEmulator : public QWidget {
 public:
     ShellEmulator(QWidget *parent = nullptr) : QWidget(parent) {
         setupUI();
-        setupProcess();
         
         // Set initial directory
         currentDir = QDir::currentPath();
@@ -161,27 +774,43 @@ public:
         
 	installEventFilter(this);
 
-        // Set focus to command input
+        // Set focus to command input (showEvent does it again once visible)
         commandInput->setFocus();
-        
-        // Force a repaint to ensure text is visible
-        commandInput->repaint();
-        
-        QTimer::singleShot(100, this, [this]() {
-            commandInput->setFocus();
-            commandInput->setCursorPosition(0);
-        });
     }
 
+    ~ShellEmulator() override {
+        // Jobs report back to this widget, so stop them before it goes away
+        for (auto &entry : jobs) {
+            Job *job = entry.second.get();
+            if (job->process) {
+                job->process->disconnect(this);
+                job->process->kill();
+                job->process->waitForFinished();
+                delete job->process;
+            }
+            if (job->runner) {
+                job->runner->disconnect(this);
+                delete job->runner;  // cancels the run and waits for it
+            }
+#ifdef Q_OS_UNIX
+            if (job->pty) {
+                job->pty->disconnect(this);
+                delete job->pty;  // kills the child and waits for it
+            }
+#endif
+        }
+    }
+
+signals:
+    // An in-process npavc run is about to start; its progress signals follow
+    void npavcStarted(NpavcRunner *runner, bool compile);
+
 protected:
     void showEvent(QShowEvent *event) override {
         QWidget::showEvent(event);
-        // Ensure focus is set when the widget is shown
-        QTimer::singleShot(50, this, [this]() {
-            commandInput->setFocus();
-            commandInput->setCursorPosition(0);
-            commandInput->repaint();
-        });
+        // Ensure focus is set when the widget is shown; it is visible by
+        // now, so this needs no timer or forced repaint
+        commandInput->setFocus();
     }
 
     void keyPressEvent(QKeyEvent *event) override {
@@ -200,6 +829,17 @@ protected:
 	    if (event->type() == QEvent::KeyPress) {
         QKeyEvent *keyEvent = static_cast<QKeyEvent*>(event);
         
+#ifdef Q_OS_UNIX
+        // While a program runs in the foreground, keys go straight to it
+        if (Job *job = terminalJob()) {
+            QByteArray keys = terminalKeys(keyEvent);
+            if (!keys.isEmpty()) {
+                job->pty->write(keys);
+                return true;
+            }
+        }
+#endif
+        
         // Handle history navigation first
         if (keyEvent->key() == Qt::Key_Up) {
             if (historyIndex > 0) {
@@ -245,10 +885,22 @@ private slots:
         historyIndex = commandHistory.size();
         
         // Display command in output
-        outputArea->append(prompt + command);
+        appendLine(prompt + command);
+        
+        // A trailing & runs the command as a background job
+        bool background = command.endsWith('&');
+        if (background) {
+            command.chop(1);
+            command = command.trimmed();
+        }
         
         // Handle built-in commands
-        if (command == "clear") {
+        if (command.isEmpty()) {
+            // nothing but "&"
+        } else if (command == "clear") {
+            flushTimer->stop();
+            pendingOutput.clear();
+            lineOpen = false;
             outputArea->clear();
             updatePrompt();
         } else if (command.startsWith("cd ")) {
@@ -261,10 +913,10 @@ private slots:
                 QDir::setCurrent(currentDir);
                 updatePrompt();
             } else {
-                outputArea->append("cd: " + path + ": No such file or directory");
+                appendLine("cd: " + path + ": No such file or directory");
             }
         } else if (command == "pwd") {
-            outputArea->append(currentDir);
+            appendLine(currentDir);
         } else if (command == "ls" || command == "dir") {
             QDir dir(currentDir);
             QStringList entries = dir.entryList(QDir::AllEntries | QDir::NoDotAndDotDot);
@@ -272,65 +924,51 @@ private slots:
                 QFileInfo info(dir.absoluteFilePath(entry));
                 QString line = info.isDir() ? "[DIR]  " : "[FILE] ";
                 line += entry;
-                outputArea->append(line);
+                appendLine(line);
             }
         } else if (command == "help") {
             showHelp();
+        } else if (command == "jobs") {
+            listJobs();
+        } else if (command == "kill" || command.startsWith("kill ")) {
+            killCommand(command.mid(4).trimmed());
+        } else if (command == "npavc" || command.startsWith("npavc ")) {
+            runNpavc(command, background);
         } else {
             // Execute external command
-            executeExternalCommand(command);
+            executeExternalCommand(command, background);
         }
         
         commandInput->clear();
         commandInput->setFocus(); // Maintain focus after execution
     }
     
-    void processFinished(int exitCode, QProcess::ExitStatus exitStatus) {
-        if (exitStatus == QProcess::CrashExit) {
-            outputArea->append("Process crashed");
-        } else {
-            outputArea->append("Process finished with exit code: " + QString::number(exitCode));
-        }
-        updatePrompt();
-        commandInput->setFocus(); // Restore focus after process finishes
-    }
-    
-    void processError(QProcess::ProcessError error) {
-        QString errorString;
-        switch (error) {
-            case QProcess::FailedToStart:
-                errorString = "Failed to start process";
-                break;
-            case QProcess::Crashed:
-                errorString = "Process crashed";
-                break;
-            case QProcess::Timedout:
-                errorString = "Process timed out";
+    // The stop button: ends the newest foreground job, or else the newest job
+    void stopJob() {
+        if (jobs.empty()) return;
+        int target = jobs.rbegin()->first;
+        for (auto it = jobs.rbegin(); it != jobs.rend(); ++it) {
+            if (!it->second->background) {
+                target = it->first;
                 break;
-            case QProcess::ReadError:
-                errorString = "Read error";
-                break;
-            case QProcess::WriteError:
-                errorString = "Write error";
-                break;
-            default:
-                errorString = "Unknown error";
+            }
         }
-        outputArea->append("Error: " + errorString);
-        updatePrompt();
-        commandInput->setFocus(); // Restore focus after error
+        killJob(target);
     }
     
-    void readProcessOutput() {
-        QByteArray data = process->readAllStandardOutput();
-        outputArea->append(QString::fromLocal8Bit(data));
+    // Draws everything collected since the last frame in one insert. The
+    // view only follows the output if it was already scrolled to the end.
+    void flushOutput() {
+        if (pendingOutput.isEmpty()) return;
+        QScrollBar *scrollBar = outputArea->verticalScrollBar();
+        bool following = scrollBar->value() == scrollBar->maximum();
+        QTextCursor cursor(outputArea->document());
+        cursor.movePosition(QTextCursor::End);
+        cursor.insertText(pendingOutput);
+        pendingOutput.clear();
+        if (following) scrollBar->setValue(scrollBar->maximum());
     }
     
-    void readProcessError() {
-        QByteArray data = process->readAllStandardError();
-        outputArea->append(QString::fromLocal8Bit(data));
-    }
-
 private:
     void setupUI() {
         setLayout(new QVBoxLayout);
@@ -338,9 +976,12 @@ private:
     // Set focus policy to accept focus
     setFocusPolicy(Qt::StrongFocus);
     
-    // Output area
-    outputArea = new QTextEdit;
+    // Output area - plain text with a capped number of lines, so old
+    // output is dropped instead of growing without bound
+    outputArea = new QPlainTextEdit;
     outputArea->setReadOnly(true);
+    outputArea->setMaximumBlockCount(MAX_SCROLLBACK_LINES);
+    outputArea->setUndoRedoEnabled(false);
     outputArea->setFont(QFont("Consolas", 10));
     outputArea->setStyleSheet("background-color: #1e1e1e; color: #ffffff; border: 1px solid #555;");
     outputArea->setFocusPolicy(Qt::NoFocus); // Don't steal focus from command input
@@ -377,124 +1018,561 @@ private:
     executeButton->setStyleSheet("background-color: #0078d4; color: white; border: none; padding: 5px 10px;");
     executeButton->setFocusPolicy(Qt::NoFocus); // Don't steal focus from command input
     
+    stopButton = new QPushButton("Stop");
+    stopButton->setStyleSheet("background-color: #c0392b; color: white; border: none; padding: 5px 10px;");
+    stopButton->setFocusPolicy(Qt::NoFocus);
+    stopButton->setEnabled(false);
+    
     inputLayout->addWidget(promptLabel);
     inputLayout->addWidget(commandInput);
     inputLayout->addWidget(executeButton);
+    inputLayout->addWidget(stopButton);
     
     layout()->addWidget(outputArea);
     layout()->addItem(inputLayout);
     
+    flushTimer = new QTimer(this);
+    flushTimer->setSingleShot(true);
+    flushTimer->setInterval(FLUSH_INTERVAL_MS);
+    connect(flushTimer, &QTimer::timeout, this, &ShellEmulator::flushOutput);
+    
     // Connect signals
     connect(commandInput, &QLineEdit::returnPressed, this, &ShellEmulator::executeCommand);
     connect(executeButton, &QPushButton::clicked, this, &ShellEmulator::executeCommand);
+    connect(stopButton, &QPushButton::clicked, this, &ShellEmulator::stopJob);
+    commandInput->installEventFilter(this);
     
     // Initial welcome message
-    outputArea->append("NPAVC Compiler Shell Emulator");
-    outputArea->append("Type 'help' for available commands");
-    outputArea->append("Type 'npavc <filename>' to compile/interpret NPAVC files");
-    outputArea->append("Use Up/Down arrows for command history");
-    outputArea->append("");
+    appendLine("NPAVC Compiler Shell Emulator");
+    appendLine("Type 'help' for available commands");
+    appendLine("Type 'npavc <filename>' to compile/interpret NPAVC files");
+    appendLine("Use Up/Down arrows for command history");
+    appendLine("");
     }
     
-    void setupProcess() {
-        process = new QProcess(this);
-        connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
-                this, &ShellEmulator::processFinished);
-        connect(process, &QProcess::errorOccurred, this, &ShellEmulator::processError);
-        connect(process, &QProcess::readyReadStandardOutput, this, &ShellEmulator::readProcessOutput);
-        connect(process, &QProcess::readyReadStandardError, this, &ShellEmulator::readProcessError);
+    // A command started from the shell: an external process or an
+    // in-process npavc run. Several can run at once.
+    struct Job {
+        int id;
+        QString command;
+        bool background;
+        QProcess *process = nullptr;
+        NpavcRunner *runner = nullptr;
+#ifdef Q_OS_UNIX
+        PtyProcess *pty = nullptr;
+#endif
+        bool carriageReturn = false;  // terminal output ended in a CR
+        // Chunks can end mid-character, so each stream has its own stateful decoder
+        QStringDecoder outputDecoder{QStringDecoder::Utf8};
+        QStringDecoder errorDecoder{QStringDecoder::Utf8};
+        QString partialLine;  // tagged output waiting for the rest of its line
+        bool killed = false;
+    };
+    
+    Job *addJob(const QString &command, bool background) {
+        auto job = std::make_unique<Job>();
+        job->id = nextJobId++;
+        job->command = command;
+        job->background = background;
+        Job *added = job.get();
+        jobs[added->id] = std::move(job);
+        if (background) {
+            appendLine(QString("[%1] %2").arg(added->id).arg(command));
+        }
+        stopButton->setEnabled(true);
+        return added;
     }
     
-    void executeExternalCommand(const QString &command) {
-        QStringList args = command.split(' ', Qt::SkipEmptyParts);
-        if (args.isEmpty()) return;
-        
-        QString program = args.takeFirst();
-        
-        process->setWorkingDirectory(currentDir);
-        process->start(program, args);
-        
-        if (!process->waitForStarted()) {
-            outputArea->append("Command not found: " + program);
-            updatePrompt();
+    // A lone foreground job writes straight to the view. Background jobs, and
+    // anything running alongside another job, are split into lines tagged
+    // with their job number so concurrent output stays readable.
+    void jobOutput(Job *job, const QString &text) {
+        bool terminal = isTerminalJob(job);
+        if (!job->background && jobs.size() == 1 && job->partialLine.isEmpty()) {
+            if (terminal) {
+                appendTerminalOutput(job, text);
+            } else {
+                appendOutput(text);
+            }
+            return;
+        }
+        job->partialLine += terminal ? QString(text).remove('\r') : text;
+        qsizetype lastNewline = job->partialLine.lastIndexOf('\n');
+        if (lastNewline < 0) return;
+        const QStringList lines = job->partialLine.left(lastNewline).split('\n');
+        job->partialLine.remove(0, lastNewline + 1);
+        QString tag = QString("[%1] ").arg(job->id);
+        for (const QString &line : lines) {
+            appendLine(tag + line);
         }
     }
     
-    void updatePrompt() {
-        QDir dir(currentDir);
-        prompt = QString("[%1] $ ").arg(dir.dirName());
-        promptLabel->setText(prompt);
+    // exitCode is -1 for a crash
+    void finishJob(Job *job, int exitCode) {
+        if (!job->partialLine.isEmpty()) {
+            appendLine(QString("[%1] %2").arg(job->id).arg(job->partialLine));
+        }
+        if (job->background) {
+            QString status = job->killed ? "Killed"
+                           : exitCode < 0 ? "Crashed"
+                           : QString("Done (exit code %1)").arg(exitCode);
+            appendLine(QString("[%1] %2  %3").arg(job->id).arg(status, job->command));
+        } else if (job->killed) {
+            appendLine("Killed");
+        } else if (exitCode < 0) {
+            appendLine("Process crashed");
+        } else {
+            appendLine("Process finished with exit code: " + QString::number(exitCode));
+        }
         
-        // Scroll to bottom
-        QTextCursor cursor = outputArea->textCursor();
-        cursor.movePosition(QTextCursor::End);
-        outputArea->setTextCursor(cursor);
+        if (job->process) {
+            job->process->disconnect(this);
+            job->process->deleteLater();
+        }
+        if (job->runner) {
+            job->runner->disconnect(this);
+            job->runner->deleteLater();
+        }
+#ifdef Q_OS_UNIX
+        if (job->pty) {
+            job->pty->disconnect(this);
+            job->pty->deleteLater();
+        }
+#endif
+        jobs.erase(job->id);
+        updateInputMode();
+        stopButton->setEnabled(!jobs.empty());
+        updatePrompt();
+        commandInput->setFocus(); // Restore focus after process finishes
     }
     
-    void showHelp() {
-        outputArea->append("Available commands:");
-        outputArea->append("  npavc <file>        - Interpret NPAVC source file");
-        outputArea->append("  npavc <file> -c     - Compile NPAVC to executable");
-        outputArea->append("  npavc <file> -c -o <name> - Compile with custom output name");
-        outputArea->append("  ls, dir             - List directory contents");
-        outputArea->append("  cd <path>           - Change directory");
-        outputArea->append("  pwd                 - Print current directory");
-        outputArea->append("  clear               - Clear screen");
-        outputArea->append("  help                - Show this help");
-        outputArea->append("");
-        outputArea->append("Keyboard shortcuts:");
-        outputArea->append("  Up/Down arrows      - Navigate command history");
-        outputArea->append("  Enter               - Execute command");
-        outputArea->append("");
-        outputArea->append("NPAVC Language Features:");
-        outputArea->append("  - C-like syntax with void main() entry point");
-        outputArea->append("  - Integer variables and arithmetic");
-        outputArea->append("  - String literals and print() function");
-        outputArea->append("  - Control flow: if/else, while loops");
-        outputArea->append("  - Comments: // and /* */");
-        outputArea->append("");
-    }
-    
-    QTextEdit *outputArea;
-    QLineEdit *commandInput;
-    QPushButton *executeButton;
-    QLabel *promptLabel;
-    QProcess *process;
-    QString currentDir;
-    QString prompt;
-    QStringList commandHistory;
-    int historyIndex = 0;
-};
-
-class CompilerExplanation : public QWidget {
-    Q_OBJECT
-
-public:
-    CompilerExplanation(QWidget *parent = nullptr) : QWidget(parent) {
-        setupUI();
+    void listJobs() {
+        if (jobs.empty()) {
+            appendLine("No jobs running");
+            return;
+        }
+        for (const auto &entry : jobs) {
+            const Job *job = entry.second.get();
+            appendLine(QString("[%1] Running  %2%3").arg(job->id).arg(job->command, job->background ? " &" : ""));
+        }
     }
-
-private:
-    void setupUI() {
-        setLayout(new QVBoxLayout);
-        
-        QScrollArea *scrollArea = new QScrollArea;
-        QWidget *contentWidget = new QWidget;
-        QVBoxLayout *contentLayout = new QVBoxLayout(contentWidget);
-        
-        // Title
-        QLabel *titleLabel = new QLabel("NPAVC Compiler Architecture");
-        titleLabel->setFont(QFont("Arial", 16, QFont::Bold));
-        titleLabel->setStyleSheet("color: #2c3e50; margin: 10px;");
-        contentLayout->addWidget(titleLabel);
-        
-        // Overview
-        addSection(contentLayout, "Overview", 
-                   "NPAVC (Not Particularly Advanced Virtual Computer) is a simple programming language "
-                   "compiler that demonstrates the fundamental concepts of language implementation. "
-                   "It supports both interpretation and compilation to C++.");
-        
-        // Lexical Analysis
+    
+    // kill <id> or kill %<id>
+    void killCommand(QString argument) {
+        if (argument.startsWith('%')) argument.remove(0, 1);
+        bool ok = false;
+        int id = argument.toInt(&ok);
+        if (!ok || jobs.find(id) == jobs.end()) {
+            appendLine("kill: no such job: " + argument);
+            return;
+        }
+        killJob(id);
+    }
+    
+    void killJob(int id) {
+        auto found = jobs.find(id);
+        if (found == jobs.end()) return;
+        Job *job = found->second.get();
+        job->killed = true;
+        if (job->process) {
+            job->process->kill();
+        } else if (job->runner) {
+            job->runner->stop();
+        }
+#ifdef Q_OS_UNIX
+        if (job->pty) job->pty->kill();
+#endif
+    }
+    
+    static bool isTerminalJob(const Job *job) {
+#ifdef Q_OS_UNIX
+        return job->pty != nullptr;
+#else
+        Q_UNUSED(job);
+        return false;
+#endif
+    }
+    
+#ifdef Q_OS_UNIX
+    // The newest foreground job on a terminal, which gets the keyboard
+    Job *terminalJob() {
+        for (auto it = jobs.rbegin(); it != jobs.rend(); ++it) {
+            Job *job = it->second.get();
+            if (job->pty && !job->background) return job;
+        }
+        return nullptr;
+    }
+    
+    // What a terminal would send for a key; empty for keys it wouldn't send
+    // anything for (modifiers on their own, function keys)
+    static QByteArray terminalKeys(const QKeyEvent *event) {
+        int key = event->key();
+        if ((event->modifiers() & Qt::ControlModifier) && key >= Qt::Key_A && key <= Qt::Key_Z) {
+            return QByteArray(1, static_cast<char>(key - Qt::Key_A + 1));
+        }
+        switch (key) {
+            case Qt::Key_Return:
+            case Qt::Key_Enter:
+                return "\r";
+            case Qt::Key_Backspace:
+                return "\x7f";
+            case Qt::Key_Tab:
+                return "\t";
+            case Qt::Key_Escape:
+                return "\x1b";
+            case Qt::Key_Up:
+                return "\x1b[A";
+            case Qt::Key_Down:
+                return "\x1b[B";
+            case Qt::Key_Right:
+                return "\x1b[C";
+            case Qt::Key_Left:
+                return "\x1b[D";
+            default:
+                return event->text().toUtf8();
+        }
+    }
+#endif
+    
+    // The command line reads commands, or with a program on the terminal,
+    // tells the user that typing goes to the program
+    void updateInputMode() {
+#ifdef Q_OS_UNIX
+        if (Job *job = terminalJob()) {
+            commandInput->setPlaceholderText(QString("Input goes to [%1] %2 (Ctrl+C interrupts)")
+                                             .arg(job->id).arg(job->command));
+            return;
+        }
+#endif
+        commandInput->setPlaceholderText(QString());
+    }
+    
+    static QString processErrorText(QProcess::ProcessError error) {
+        switch (error) {
+            case QProcess::FailedToStart:
+                return "Failed to start process";
+            case QProcess::Crashed:
+                return "Process crashed";
+            case QProcess::Timedout:
+                return "Process timed out";
+            case QProcess::ReadError:
+                return "Read error";
+            case QProcess::WriteError:
+                return "Write error";
+            default:
+                return "Unknown error";
+        }
+    }
+    
+    // Handles `npavc <file> [options]` with the linked-in compiler rather than
+    // an external npavc binary; accepts the same options as the command line
+    void runNpavc(const QString &command, bool background) {
+        QStringList args = command.split(' ', Qt::SkipEmptyParts);
+        args.removeFirst();
+        if (args.isEmpty()) {
+            appendLine("Usage: npavc <source_file> [-c] [-o <name>] [--no-bounds-check] "
+                               "[--max-stack <n>] [--max-depth <n>]");
+            return;
+        }
+        QString filename = args[0];
+        bool compile = false;
+        QString outputName;
+        RunOptions options;
+        for (int i = 1; i < args.size(); i++) {
+            const QString &arg = args[i];
+            if (arg == "-c" || arg == "--compile") {
+                compile = true;
+            } else if (arg == "-o" && i + 1 < args.size()) {
+                outputName = args[++i];
+            } else if (arg == "--no-bounds-check") {
+                options.boundsChecks = false;
+            } else if ((arg == "--max-stack" || arg == "--max-depth") && i + 1 < args.size()) {
+                // toULongLong() gives 0 (no limit at all) for anything it can't read
+                bool valid = false;
+                qulonglong limit = args[++i].toULongLong(&valid);
+                if (!valid || limit > std::numeric_limits<size_t>::max()) {
+                    appendLine("Error: Invalid value for " + arg + ": '" + args[i] + "'");
+                    return;
+                }
+                (arg == "--max-stack" ? options.maxStack : options.maxDepth) = static_cast<size_t>(limit);
+            }
+        }
+        
+        // The run goes on in the background while the shell may cd elsewhere,
+        // and g++ resolves relative paths against the process's directory, so
+        // the runner only gets absolute ones
+        QDir dir(currentDir);
+        QString path = dir.absoluteFilePath(filename);
+        if (!outputName.isEmpty()) {
+            outputName = dir.absoluteFilePath(outputName);
+        }
+        
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            appendLine("Error: Could not open file '" + filename + "'");
+            return;
+        }
+        QByteArray source = file.readAll();
+        if (source.isEmpty()) {
+            appendLine("Error: File '" + filename + "' is empty");
+            return;
+        }
+        
+        Job *job = addJob(command, background);
+        job->runner = new NpavcRunner(this);
+        // The runner hands over output exactly as the program wrote it
+        connect(job->runner, &NpavcRunner::output, this, [this, job](const QString &text) {
+            jobOutput(job, text);
+        });
+        connect(job->runner, &NpavcRunner::error, this, [this, job](const QString &text) {
+            jobOutput(job, text);
+        });
+        connect(job->runner, &NpavcRunner::finished, this, [this, job](int exitCode) {
+            finishJob(job, exitCode);
+        });
+        emit npavcStarted(job->runner, compile);  // before start, so no progress signal is missed
+        job->runner->start(path.toStdString(), source.toStdString(), compile, outputName.toStdString(), options);
+    }
+    
+    // Starts the process and returns at once; a failure to start is
+    // reported through errorOccurred rather than by blocking here
+    void executeExternalCommand(const QString &command, bool background) {
+        QStringList args = QProcess::splitCommand(command);
+        if (args.isEmpty()) return;
+        
+        QString program = args.takeFirst();
+        
+#ifdef Q_OS_UNIX
+        PtyProcess *pty = new PtyProcess(this);
+        QFontMetrics metrics(outputArea->font());
+        int columns = qMax(20, outputArea->viewport()->width() / qMax(1, metrics.horizontalAdvance('M')));
+        int rows = qMax(5, outputArea->viewport()->height() / qMax(1, metrics.lineSpacing()));
+        if (!pty->start(program, args, currentDir, columns, rows)) {
+            appendLine("Command not found: " + program);
+            delete pty;
+            updatePrompt();
+            return;
+        }
+        Job *job = addJob(command, background);
+        job->pty = pty;
+        connect(pty, &PtyProcess::readyRead, this, [this, job](const QByteArray &data) {
+            jobOutput(job, job->outputDecoder.decode(data));
+        });
+        connect(pty, &PtyProcess::finished, this, [this, job](int exitCode, bool crashed) {
+            finishJob(job, crashed ? -1 : exitCode);
+        });
+        updateInputMode();
+#else
+        Job *job = addJob(command, background);
+        job->process = new QProcess(this);
+        job->process->setWorkingDirectory(currentDir);
+        connect(job->process, &QProcess::readyReadStandardOutput, this, [this, job]() {
+            jobOutput(job, job->outputDecoder.decode(job->process->readAllStandardOutput()));
+        });
+        connect(job->process, &QProcess::readyReadStandardError, this, [this, job]() {
+            jobOutput(job, job->errorDecoder.decode(job->process->readAllStandardError()));
+        });
+        connect(job->process, &QProcess::finished, this, [this, job](int exitCode, QProcess::ExitStatus exitStatus) {
+            finishJob(job, exitStatus == QProcess::CrashExit ? -1 : exitCode);
+        });
+        connect(job->process, &QProcess::errorOccurred, this, [this, job, program](QProcess::ProcessError error) {
+            if (error == QProcess::FailedToStart) {
+                // No finished() follows a failed start
+                appendLine("Command not found: " + program);
+                job->process->disconnect(this);
+                job->process->deleteLater();
+                job->process = nullptr;
+                jobs.erase(job->id);
+                stopButton->setEnabled(!jobs.empty());
+                updatePrompt();
+            } else if (error != QProcess::Crashed) {
+                // Crashes are reported when the job finishes
+                appendLine(QString("[%1] Error: %2").arg(job->id).arg(processErrorText(error)));
+            }
+        });
+        job->process->start(program, args);
+#endif
+    }
+    
+    // Program output from a terminal: lines end in CR LF, a bare CR returns
+    // to the start of the line (progress meters redraw themselves that way)
+    // and erasing a typed character echoes as "\b \b". The view only appends,
+    // so a CR followed by more text replaces the line and a backspace
+    // removes the character before it.
+    void appendTerminalOutput(Job *job, const QString &text) {
+        QString plain;
+        for (QChar ch : text) {
+            if (job->carriageReturn && ch != '\n' && ch != '\r') {
+                appendOutput(plain);
+                plain.clear();
+                eraseInLine(-1);
+            }
+            job->carriageReturn = false;
+            if (ch == '\r') {
+                job->carriageReturn = true;
+            } else if (ch == '\b') {
+                appendOutput(plain);
+                plain.clear();
+                eraseInLine(1);
+            } else {
+                plain += ch;
+            }
+        }
+        appendOutput(plain);
+    }
+    
+    // Removes the last count characters of the current line, or the whole
+    // line for a negative count. Most of the time the line is still pending;
+    // only when it was already drawn does the document get touched.
+    void eraseInLine(qsizetype count) {
+        qsizetype lineStart = pendingOutput.lastIndexOf('\n') + 1;
+        qsizetype pending = pendingOutput.size() - lineStart;
+        qsizetype fromPending = count < 0 ? pending : qMin(count, pending);
+        pendingOutput.chop(fromPending);
+        if (lineStart == 0 && (count < 0 || count > fromPending)) {
+            QTextCursor cursor(outputArea->document());
+            cursor.movePosition(QTextCursor::End);
+            if (count < 0) {
+                cursor.movePosition(QTextCursor::StartOfBlock, QTextCursor::KeepAnchor);
+            } else {
+                int inBlock = cursor.positionInBlock();
+                cursor.movePosition(QTextCursor::Left, QTextCursor::KeepAnchor,
+                                    static_cast<int>(qMin<qsizetype>(count - fromPending, inBlock)));
+            }
+            cursor.removeSelectedText();
+        }
+        if (count < 0) lineOpen = false;
+    }
+    
+    // Raw program output, shown exactly as written
+    void appendOutput(const QString &text) {
+        if (text.isEmpty()) return;
+        pendingOutput += text;
+        lineOpen = !text.endsWith('\n');
+        scheduleFlush();
+    }
+    
+    // A line of its own, after any unterminated program output
+    void appendLine(const QString &text) {
+        if (lineOpen) pendingOutput += '\n';
+        pendingOutput += text;
+        pendingOutput += '\n';
+        lineOpen = false;
+        scheduleFlush();
+    }
+    
+    void scheduleFlush() {
+        if (pendingOutput.size() > MAX_PENDING_CHARS) trimPendingOutput();
+        if (!flushTimer->isActive()) flushTimer->start();
+    }
+    
+    // Between frames a fast program can produce far more than the view keeps;
+    // only the last MAX_SCROLLBACK_LINES lines (and MAX_PENDING_CHARS) survive
+    void trimPendingOutput() {
+        qsizetype cut = pendingOutput.size();
+        for (int lines = 0; lines <= MAX_SCROLLBACK_LINES && cut > 0; lines++) {
+            cut = pendingOutput.lastIndexOf('\n', cut - 1);
+            if (cut < 0) break;
+        }
+        if (cut > 0) pendingOutput.remove(0, cut + 1);
+        if (pendingOutput.size() > MAX_PENDING_CHARS) {
+            pendingOutput.remove(0, pendingOutput.size() - MAX_PENDING_CHARS);
+        }
+    }
+    
+    void updatePrompt() {
+        QDir dir(currentDir);
+        prompt = QString("[%1] $ ").arg(dir.dirName());
+        promptLabel->setText(prompt);
+        
+        // Scroll to bottom
+        QTextCursor cursor = outputArea->textCursor();
+        cursor.movePosition(QTextCursor::End);
+        outputArea->setTextCursor(cursor);
+    }
+    
+    void showHelp() {
+        appendLine("Available commands:");
+        appendLine("  npavc <file>        - Interpret NPAVC source file");
+        appendLine("  npavc <file> -c     - Compile NPAVC to executable");
+        appendLine("  npavc <file> -c -o <name> - Compile with custom output name");
+        appendLine("  npavc <file> --no-bounds-check - Skip array index checks");
+        appendLine("  npavc <file> --max-depth <n> - Limit interpreter recursion depth (default 1048576)");
+        appendLine("  ls, dir             - List directory contents");
+        appendLine("  cd <path>           - Change directory");
+        appendLine("  pwd                 - Print current directory");
+        appendLine("  clear               - Clear screen");
+        appendLine("  help                - Show this help");
+        appendLine("  <command> &         - Run a command in the background");
+        appendLine("  jobs                - List running jobs");
+        appendLine("  kill <id>           - Stop a job (the Stop button stops the newest)");
+        appendLine("  While a program runs, keys typed go straight to it");
+        appendLine("");
+        appendLine("Keyboard shortcuts:");
+        appendLine("  Up/Down arrows      - Navigate command history");
+        appendLine("  Enter               - Execute command");
+        appendLine("");
+        appendLine("NPAVC Language Features:");
+        appendLine("  - C-like syntax with void main() entry point");
+        appendLine("  - Functions: int name(int a, int b) { return a + b; }");
+        appendLine("  - Integer variables and arithmetic (+ - * / %, unary -, && ||)");
+        appendLine("  - Fixed-size int arrays: int a[10]; a[i] = a[i] + 1;");
+        appendLine("  - String variables with + concatenation, ==/!= and len()");
+        appendLine("  - String literals and print() function");
+        appendLine("  - Control flow: if/else, while and for loops");
+        appendLine("  - Comments: // and /* */");
+        appendLine("");
+    }
+    
+    static const int MAX_SCROLLBACK_LINES = 10000;
+    static const int FLUSH_INTERVAL_MS = 33;  // ~30 frames per second
+    static const qsizetype MAX_PENDING_CHARS = 1 << 20;
+    
+    QPlainTextEdit *outputArea;
+    QTimer *flushTimer;
+    QString pendingOutput;
+    bool lineOpen = false;  // the output so far ends mid-line
+    QLineEdit *commandInput;
+    QPushButton *executeButton;
+    QPushButton *stopButton;
+    QLabel *promptLabel;
+    std::map<int, std::unique_ptr<Job>> jobs;
+    int nextJobId = 1;
+    QString currentDir;
+    QString prompt;
+    QStringList commandHistory;
+    int historyIndex = 0;
+};
+
+class CompilerExplanation : public QWidget {
+    Q_OBJECT
+
+public:
+    CompilerExplanation(QWidget *parent = nullptr) : QWidget(parent) {
+        setupUI();
+    }
+
+private:
+    void setupUI() {
+        setLayout(new QVBoxLayout);
+        
+        QScrollArea *scrollArea = new QScrollArea;
+        QWidget *contentWidget = new QWidget;
+        QVBoxLayout *contentLayout = new QVBoxLayout(contentWidget);
+        
+        // Title
+        QLabel *titleLabel = new QLabel("NPAVC Compiler Architecture");
+        titleLabel->setFont(QFont("Arial", 16, QFont::Bold));
+        titleLabel->setStyleSheet("color: #2c3e50; margin: 10px;");
+        contentLayout->addWidget(titleLabel);
+        
+        // Overview
+        addSection(contentLayout, "Overview", 
+                   "NPAVC (Not Particularly Advanced Virtual Computer) is a simple programming language "
+                   "compiler that demonstrates the fundamental concepts of language implementation. "
+                   "It supports both interpretation and compilation to C++.");
+        
+        // Lexical Analysis
         addSection(contentLayout, "1. Lexical Analysis (Tokenization)", 
                    "The lexer converts the source code into a stream of tokens. Each token represents "
                    "a meaningful unit like keywords, identifiers, operators, or literals.\n\n"
@@ -510,9 +1588,9 @@ private:
                    "The parser takes the token stream and builds an Abstract Syntax Tree (AST) "
                    "according to the language grammar.\n\n"
                    "Parser features:\n"
-                   "• Recursive descent parsing\n"
-                   "• Operator precedence handling\n"
-                   "• Expression parsing (arithmetic, comparison)\n"
+                   "• Recursive descent parsing for statements\n"
+                   "• Table-driven precedence climbing for expressions\n"
+                   "• Expression parsing (arithmetic, comparison, logical)\n"
                    "• Statement parsing (assignments, control flow)\n"
                    "• Error recovery and reporting");
         
@@ -550,10 +1628,10 @@ private:
         // Language Features
         addSection(contentLayout, "Language Features", 
                    "NPAVC supports a subset of C-like features:\n\n"
-                   "• Data types: int, string literals\n"
-                   "• Operators: +, -, *, /, ==, !=, <, >, <=, >=\n"
-                   "• Control flow: if/else, while loops\n"
-                   "• Functions: print() for output\n"
+                   "• Data types: int, string, fixed-size int arrays\n"
+                   "• Operators: +, -, *, /, %, unary -, ==, !=, <, >, <=, >=, &&, ||\n"
+                   "• Control flow: if/else, while and for loops\n"
+                   "• Functions: int name(int a, ...) definitions, print() for output, len() for string length\n"
                    "• Comments: // single-line, /* multi-line */\n"
                    "• Variables: declaration and assignment");
         
@@ -596,6 +1674,972 @@ private:
     }
 };
 
+// Table of the tokens of a lexed file. QTableView only asks for the rows it
+// shows, so a million tokens cost one std::vector and nothing per row.
+class TokenModel : public QAbstractTableModel {
+    Q_OBJECT
+
+public:
+    TokenModel(QObject *parent = nullptr) : QAbstractTableModel(parent) {}
+    
+    void setTokens(std::vector<Token> lexed) {
+        beginResetModel();
+        tokens = std::move(lexed);
+        endResetModel();
+    }
+    
+    const Token *tokenAt(const QModelIndex &index) const {
+        if (!index.isValid() || index.row() >= static_cast<int>(tokens.size())) return nullptr;
+        return &tokens[index.row()];
+    }
+    
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override {
+        return parent.isValid() ? 0 : static_cast<int>(tokens.size());
+    }
+    
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override {
+        return parent.isValid() ? 0 : 4;
+    }
+    
+    QVariant data(const QModelIndex &index, int role) const override {
+        const Token *token = tokenAt(index);
+        if (!token || role != Qt::DisplayRole) return QVariant();
+        switch (index.column()) {
+            case 0: return QString(tokenTypeName(token->type));
+            case 1: return QString::fromStdString(token->value);
+            case 2: return token->line;
+            default: return token->column;
+        }
+    }
+    
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const override {
+        if (role != Qt::DisplayRole) return QVariant();
+        if (orientation == Qt::Vertical) return section;
+        static const char *titles[] = {"Type", "Value", "Line", "Column"};
+        return QString(titles[section]);
+    }
+
+private:
+    std::vector<Token> tokens;
+};
+
+// Tree of a parsed program. Items are only created for children whose parent
+// has been expanded, and a node with many children hands them out
+// FETCH_BATCH at a time as the view scrolls (canFetchMore/fetchMore), so
+// opening the huge statement list of a generated file stays cheap.
+class AstModel : public QAbstractItemModel {
+    Q_OBJECT
+
+public:
+    AstModel(QObject *parent = nullptr) : QAbstractItemModel(parent) {}
+    
+    // Takes ownership of program (which may be null)
+    void setProgram(ASTNode *program) {
+        beginResetModel();
+        root.reset();
+        delete ast;
+        ast = program;
+        if (ast) root = std::make_unique<Item>(Item{ast, nullptr, 0});
+        endResetModel();
+    }
+    
+    ~AstModel() override {
+        root.reset();
+        delete ast;
+    }
+    
+    // The source range for an index: its own for statements and functions,
+    // the closest enclosing statement's for expressions
+    bool sourceRange(const QModelIndex &index, size_t &start, size_t &end) const {
+        for (const Item *item = itemAt(index); item; item = item->parent) {
+            if (item->node->end > item->node->start) {
+                start = item->node->start;
+                end = item->node->end;
+                return true;
+            }
+        }
+        return false;
+    }
+    
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override {
+        if (!hasIndex(row, column, parent)) return QModelIndex();
+        if (!parent.isValid()) return createIndex(row, column, root.get());
+        return createIndex(row, column, itemAt(parent)->children[row].get());
+    }
+    
+    QModelIndex parent(const QModelIndex &index) const override {
+        const Item *item = itemAt(index);
+        if (!item || !item->parent) return QModelIndex();
+        return createIndex(item->parent->row, 0, item->parent);
+    }
+    
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override {
+        if (parent.column() > 0) return 0;
+        if (!parent.isValid()) return root ? 1 : 0;
+        return static_cast<int>(itemAt(parent)->children.size());
+    }
+    
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override {
+        Q_UNUSED(parent);
+        return 3;
+    }
+    
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const override {
+        if (!parent.isValid()) return root != nullptr;
+        if (parent.column() > 0) return false;
+        const Item *item = itemAt(parent);
+        return !item->node->children.empty();
+    }
+    
+    bool canFetchMore(const QModelIndex &parent) const override {
+        if (!parent.isValid()) return false;
+        const Item *item = itemAt(parent);
+        return item->children.size() < item->node->children.size();
+    }
+    
+    void fetchMore(const QModelIndex &parent) override {
+        Item *item = itemAt(parent);
+        const std::vector<ASTNode *> &children = item->node->children;
+        std::vector<std::unique_ptr<Item>> batch;
+        size_t next = item->children.size();
+        while (next < children.size() && batch.size() < FETCH_BATCH) {
+            batch.push_back(std::make_unique<Item>(Item{children[next], item, static_cast<int>(next)}));
+            next++;
+        }
+        if (batch.empty()) return;
+        int first = static_cast<int>(item->children.size());
+        beginInsertRows(parent, first, first + static_cast<int>(batch.size()) - 1);
+        for (auto &child : batch) item->children.push_back(std::move(child));
+        endInsertRows();
+    }
+    
+    QVariant data(const QModelIndex &index, int role) const override {
+        const Item *item = itemAt(index);
+        if (!item) return QVariant();
+        const ASTNode *node = item->node;
+        if (role == Qt::ToolTipRole) {
+            return QString("%1 children").arg(node->children.size());
+        }
+        if (role != Qt::DisplayRole) return QVariant();
+        switch (index.column()) {
+            case 0: return QString(nodeTypeName(node->type));
+            case 1: return QString::fromStdString(node->value);
+            default: return node->line > 0 ? QString("%1:%2").arg(node->line).arg(node->column) : QString();
+        }
+    }
+    
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const override {
+        if (orientation != Qt::Horizontal || role != Qt::DisplayRole) return QVariant();
+        static const char *titles[] = {"Node", "Value", "Line"};
+        return QString(titles[section]);
+    }
+
+private:
+    static const size_t FETCH_BATCH = 1000;
+    
+    struct Item {
+        ASTNode *node;
+        Item *parent;
+        int row;
+        std::vector<std::unique_ptr<Item>> children;  // the first children.size() of node->children
+    };
+    
+    static Item *itemAt(const QModelIndex &index) {
+        return index.isValid() ? static_cast<Item *>(index.internalPointer()) : nullptr;
+    }
+    
+    ASTNode *ast = nullptr;
+    std::unique_ptr<Item> root;
+};
+
+// Browses the tokens and syntax tree of a file, with the source alongside.
+// Lexing and parsing run on a worker thread and the models materialize rows
+// on demand, so large generated inputs can be inspected; the status line
+// says how long each step took.
+class ProgramExplorer : public QWidget {
+    Q_OBJECT
+
+public:
+    ProgramExplorer(QWidget *parent = nullptr) : QWidget(parent) {
+        QVBoxLayout *layout = new QVBoxLayout(this);
+        
+        QHBoxLayout *fileLayout = new QHBoxLayout;
+        pathInput = new QLineEdit;
+        pathInput->setPlaceholderText("Path to a .npav file");
+        QPushButton *browseButton = new QPushButton("Browse...");
+        loadButton = new QPushButton("Load");
+        fileLayout->addWidget(pathInput);
+        fileLayout->addWidget(browseButton);
+        fileLayout->addWidget(loadButton);
+        layout->addLayout(fileLayout);
+        
+        tokenModel = new TokenModel(this);
+        tokenView = new QTableView;
+        tokenView->setModel(tokenModel);
+        tokenView->setSelectionBehavior(QAbstractItemView::SelectRows);
+        tokenView->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+        tokenView->verticalHeader()->setDefaultSectionSize(20);
+        tokenView->horizontalHeader()->setStretchLastSection(true);
+        
+        astModel = new AstModel(this);
+        astView = new QTreeView;
+        astView->setModel(astModel);
+        astView->setUniformRowHeights(true);
+        astView->header()->setStretchLastSection(true);
+        
+        QTabWidget *views = new QTabWidget;
+        views->addTab(astView, "Syntax Tree");
+        views->addTab(tokenView, "Tokens");
+        
+        sourceView = new QPlainTextEdit;
+        sourceView->setReadOnly(true);
+        sourceView->setFont(QFont("Consolas", 10));
+        sourceView->setLineWrapMode(QPlainTextEdit::NoWrap);
+        
+        QSplitter *splitter = new QSplitter;
+        splitter->addWidget(views);
+        splitter->addWidget(sourceView);
+        layout->addWidget(splitter, 1);
+        
+        statusLabel = new QLabel("Load a file to see its tokens and syntax tree");
+        layout->addWidget(statusLabel);
+        
+        connect(pathInput, &QLineEdit::returnPressed, this, &ProgramExplorer::load);
+        connect(loadButton, &QPushButton::clicked, this, &ProgramExplorer::load);
+        connect(browseButton, &QPushButton::clicked, this, [this]() {
+            QString path = QFileDialog::getOpenFileName(this, "Open NPAVC source", pathInput->text(),
+                                                        "NPAVC source (*.npav *.npavc);;All files (*)");
+            if (path.isEmpty()) return;
+            pathInput->setText(path);
+            load();
+        });
+        connect(tokenView->selectionModel(), &QItemSelectionModel::currentRowChanged, this,
+                [this](const QModelIndex &current) {
+            if (const Token *token = tokenModel->tokenAt(current)) showSource(token->start, token->end);
+        });
+        connect(astView->selectionModel(), &QItemSelectionModel::currentRowChanged, this,
+                [this](const QModelIndex &current) {
+            size_t start, end;
+            if (astModel->sourceRange(current, start, end)) showSource(start, end);
+        });
+    }
+    
+    ~ProgramExplorer() override {
+        if (loader) {
+            loader->wait();
+            delete loader;
+        }
+    }
+
+private:
+    // What the worker thread hands back
+    struct LoadResult {
+        ~LoadResult() { delete program; }
+        
+        QString error;
+        QString lexError;
+        std::string source;
+        std::vector<Token> tokens;
+        ASTNode *program = nullptr;
+        QString parseErrors;
+        double lexSeconds = 0;
+        double parseSeconds = 0;
+        size_t nodes = 0;
+    };
+    
+    void load() {
+        QString path = pathInput->text().trimmed();
+        if (path.isEmpty() || loader) return;
+        loadButton->setEnabled(false);
+        statusLabel->setText("Loading " + path + "...");
+        
+        auto result = std::make_shared<LoadResult>();
+        loader = QThread::create([result, path]() {
+            std::ifstream file(path.toStdString(), std::ios::binary);
+            if (!file) {
+                result->error = "Could not open " + path;
+                return;
+            }
+            std::ostringstream contents;
+            contents << file.rdbuf();
+            result->source = contents.str();
+            
+            // Anything thrown here would escape the thread and end the
+            // program, so every failure becomes a message instead
+            std::ostringstream warnings;
+            QElapsedTimer timer;
+            timer.start();
+            try {
+                Lexer lexer(result->source, warnings);
+                result->tokens = lexer.tokenize();
+            } catch (const std::exception &e) {
+                result->tokens.clear();
+                result->lexError = QString::fromStdString(e.what());
+                return;
+            }
+            result->lexSeconds = timer.nsecsElapsed() / 1e9;
+            
+            // The recovering parse, so a file with syntax errors still shows
+            // the tree of the statements that did parse
+            timer.restart();
+            try {
+                Parser parser(result->tokens);
+                result->program = parser.parseProgram();
+                const std::vector<Diagnostic> &diagnostics = parser.getDiagnostics();
+                if (!diagnostics.empty()) {
+                    const Diagnostic &first = diagnostics.front();
+                    result->parseErrors = QString("%1 syntax error(s), first at %2:%3: %4").arg(diagnostics.size())
+                                          .arg(first.line).arg(first.column).arg(QString::fromStdString(first.message));
+                }
+            } catch (const std::exception &e) {
+                result->parseErrors = QString::fromStdString(e.what());
+            }
+            result->parseSeconds = timer.nsecsElapsed() / 1e9;
+            if (result->program) result->nodes = TimeReport::countNodes(result->program);
+        });
+        connect(loader, &QThread::finished, this, [this, result]() {
+            loader->deleteLater();
+            loader = nullptr;
+            loadButton->setEnabled(true);
+            showResult(*result);
+        });
+        loader->start();
+    }
+    
+    void showResult(LoadResult &result) {
+        if (!result.error.isEmpty()) {
+            statusLabel->setText(result.error);
+            return;
+        }
+        sourceBytes = std::move(result.source);
+        sourceView->setPlainText(QString::fromStdString(sourceBytes));
+        
+        size_t tokenCount = result.tokens.size();
+        tokenModel->setTokens(std::move(result.tokens));
+        astModel->setProgram(result.program);
+        result.program = nullptr;
+        if (astModel->rowCount() > 0) astView->expand(astModel->index(0, 0));
+        
+        if (!result.lexError.isEmpty()) {
+            statusLabel->setText("Could not lex the file: " + result.lexError);
+            return;
+        }
+        QString status = QString("%1 tokens lexed in %2 ms")
+                         .arg(tokenCount).arg(result.lexSeconds * 1e3, 0, 'f', 1);
+        status += QString(", %1 nodes parsed in %2 ms").arg(result.nodes).arg(result.parseSeconds * 1e3, 0, 'f', 1);
+        if (!result.parseErrors.isEmpty()) {
+            status += " - " + result.parseErrors.section('\n', 0, 0);
+        }
+        statusLabel->setText(status);
+    }
+    
+    // Selects source bytes [start, end). The core counts UTF-8 bytes and the
+    // document UTF-16 units, which only differ after non-ASCII text.
+    void showSource(size_t start, size_t end) {
+        start = std::min(start, sourceBytes.size());
+        end = std::min(std::max(end, start), sourceBytes.size());
+        int from = static_cast<int>(QString::fromUtf8(sourceBytes.data(), static_cast<qsizetype>(start)).size());
+        int to = from + static_cast<int>(QString::fromUtf8(sourceBytes.data() + start,
+                                                           static_cast<qsizetype>(end - start)).size());
+        QTextCursor cursor(sourceView->document());
+        cursor.setPosition(from);
+        cursor.setPosition(to, QTextCursor::KeepAnchor);
+        sourceView->setTextCursor(cursor);
+        sourceView->centerCursor();
+    }
+    
+    QLineEdit *pathInput;
+    QPushButton *loadButton;
+    TokenModel *tokenModel;
+    QTableView *tokenView;
+    AstModel *astModel;
+    QTreeView *astView;
+    QPlainTextEdit *sourceView;
+    QLabel *statusLabel;
+    QThread *loader = nullptr;
+    std::string sourceBytes;
+};
+
+// A syntax error shown in the editor
+struct EditorDiagnostic {
+    int line;
+    int column;
+    QString message;
+};
+
+// Plain text editor that colours npav source with the compiler's own lexer
+// (Lexer::lexLine). Only the blocks on screen are ever highlighted: a
+// block's formats are set when it scrolls into view or is edited, so opening
+// or typing in a file of several megabytes costs the same as a small one.
+// What a line leaves open for the next (a block comment or string) is kept
+// in each block's userState; states are trusted up to validUpTo and
+// recomputed from there, without formatting, when a later block needs one.
+class CodeEditor : public QPlainTextEdit {
+    Q_OBJECT
+
+public:
+    CodeEditor(QWidget *parent = nullptr) : QPlainTextEdit(parent) {
+        setFont(QFont("Consolas", 10));
+        setLineWrapMode(QPlainTextEdit::NoWrap);
+        
+        keywordFormat.setForeground(QColor(0, 0, 160));
+        keywordFormat.setFontWeight(QFont::Bold);
+        numberFormat.setForeground(QColor(170, 85, 0));
+        stringFormat.setForeground(QColor(0, 128, 0));
+        commentFormat.setForeground(QColor(128, 128, 128));
+        commentFormat.setFontItalic(true);
+        
+        connect(document(), &QTextDocument::contentsChange, this, &CodeEditor::contentsChanged);
+        connect(verticalScrollBar(), &QScrollBar::valueChanged, this, &CodeEditor::highlightVisible);
+        // Picks up lines whose start state changed after an edit further up
+        highlightTimer = new QTimer(this);
+        highlightTimer->setSingleShot(true);
+        highlightTimer->setInterval(0);
+        connect(highlightTimer, &QTimer::timeout, this, &CodeEditor::highlightVisible);
+    }
+    
+    void setDiagnostics(const std::vector<EditorDiagnostic> &found) {
+        diagnostics = found;
+        QList<QTextEdit::ExtraSelection> selections;
+        for (const EditorDiagnostic &diagnostic : diagnostics) {
+            QTextBlock block = document()->findBlockByNumber(diagnostic.line - 1);
+            if (!block.isValid()) continue;
+            QTextEdit::ExtraSelection selection;
+            selection.cursor = QTextCursor(block);
+            selection.cursor.setPosition(block.position() + qBound(0, diagnostic.column - 1, block.length() - 1));
+            selection.cursor.movePosition(QTextCursor::EndOfWord, QTextCursor::KeepAnchor);
+            if (!selection.cursor.hasSelection()) selection.cursor.movePosition(QTextCursor::Right, QTextCursor::KeepAnchor);
+            selection.format.setUnderlineStyle(QTextCharFormat::SpellCheckUnderline);
+            selection.format.setUnderlineColor(Qt::red);
+            selections.append(selection);
+        }
+        setExtraSelections(selections);
+    }
+
+signals:
+    // A change to the text itself, as opposed to re-formatting
+    void textEdited(int position, int removed, int added);
+
+protected:
+    void resizeEvent(QResizeEvent *event) override {
+        QPlainTextEdit::resizeEvent(event);
+        highlightVisible();
+    }
+    
+    // Hovering an underlined line shows its errors
+    bool viewportEvent(QEvent *event) override {
+        if (event->type() == QEvent::ToolTip) {
+            QHelpEvent *help = static_cast<QHelpEvent *>(event);
+            int line = cursorForPosition(help->pos()).blockNumber() + 1;
+            QStringList messages;
+            for (const EditorDiagnostic &diagnostic : diagnostics) {
+                if (diagnostic.line == line) messages << diagnostic.message;
+            }
+            if (messages.isEmpty()) {
+                QToolTip::hideText();
+            } else {
+                QToolTip::showText(help->globalPos(), messages.join('\n'), viewport());
+            }
+            return true;
+        }
+        return QPlainTextEdit::viewportEvent(event);
+    }
+
+private slots:
+    void contentsChanged(int position, int removed, int added) {
+        if (formatting) return;  // our own markContentsDirty
+        emit textEdited(position, removed, added);
+        QTextBlock first = document()->findBlock(position);
+        validUpTo = qMin(validUpTo, first.blockNumber());
+        // The edited lines are redone right away so typing never shows them
+        // plain; a large paste is left to the visible pass
+        QTextBlock last = document()->findBlock(position + added);
+        int count = 0;
+        for (QTextBlock block = first; block.isValid() && count < MAX_EDIT_BLOCKS; block = block.next(), count++) {
+            highlightBlock(block);
+            if (block == last) break;
+        }
+        highlightTimer->start();
+    }
+    
+    void highlightVisible() {
+        QTextBlock block = firstVisibleBlock();
+        QPointF offset = contentOffset();
+        int bottom = viewport()->height();
+        while (block.isValid() && blockBoundingGeometry(block).translated(offset).top() <= bottom) {
+            highlightBlock(block);
+            block = block.next();
+        }
+    }
+
+private:
+    static const int MAX_EDIT_BLOCKS = 100;
+    
+    // What a block was last formatted from; formatting it again from the
+    // same text and start state would change nothing
+    struct HighlightKey : QTextBlockUserData {
+        int revision;
+        int startState;
+        HighlightKey(int revision, int startState) : revision(revision), startState(startState) {}
+    };
+    
+    // The state block starts in, bringing the stored states up to it first
+    LexState startState(const QTextBlock &block) {
+        int number = block.blockNumber();
+        if (number == 0) return LEX_CODE;
+        if (validUpTo < number) {
+            QTextBlock scan = document()->findBlockByNumber(validUpTo);
+            LexState state = validUpTo == 0 ? LEX_CODE : static_cast<LexState>(scan.previous().userState());
+            std::vector<LexSpan> spans;
+            for (; scan.isValid() && scan.blockNumber() < number; scan = scan.next()) {
+                spans.clear();
+                state = Lexer::lexLine(scan.text().toStdString(), state, spans);
+                scan.setUserState(state);
+            }
+            validUpTo = number;
+        }
+        return static_cast<LexState>(block.previous().userState());
+    }
+    
+    void highlightBlock(QTextBlock block) {
+        LexState state = startState(block);
+        QString text = block.text();
+        std::string bytes = text.toStdString();
+        std::vector<LexSpan> spans;
+        LexState endState = Lexer::lexLine(bytes, state, spans);
+        block.setUserState(endState);
+        if (validUpTo == block.blockNumber()) validUpTo++;
+        
+        HighlightKey *key = static_cast<HighlightKey *>(block.userData());
+        if (key && key->revision == block.revision() && key->startState == state) return;
+        
+        // Offsets are UTF-8 bytes; the layout wants UTF-16 units
+        bool ascii = bytes.size() == static_cast<size_t>(text.size());
+        auto position = [&](size_t offset) {
+            return ascii ? static_cast<int>(offset)
+                         : static_cast<int>(QString::fromUtf8(bytes.data(), static_cast<qsizetype>(offset)).size());
+        };
+        QList<QTextLayout::FormatRange> ranges;
+        for (const LexSpan &span : spans) {
+            const QTextCharFormat *format = formatFor(span);
+            if (!format) continue;
+            QTextLayout::FormatRange range;
+            range.start = position(span.start);
+            range.length = position(span.end) - range.start;
+            range.format = *format;
+            ranges.append(range);
+        }
+        
+        block.setUserData(new HighlightKey(block.revision(), state));
+        formatting = true;
+        block.layout()->setFormats(ranges);
+        document()->markContentsDirty(block.position(), block.length());
+        formatting = false;
+    }
+    
+    const QTextCharFormat *formatFor(const LexSpan &span) const {
+        if (span.comment) return &commentFormat;
+        switch (span.type) {
+            case VOID: case MAIN: case INT: case STRING_TYPE:
+            case IF: case ELSE: case WHILE: case FOR: case RETURN:
+                return &keywordFormat;
+            case NUMBER:
+                return &numberFormat;
+            case STRING:
+                return &stringFormat;
+            default:
+                return nullptr;
+        }
+    }
+    
+    QTextCharFormat keywordFormat;
+    QTextCharFormat numberFormat;
+    QTextCharFormat stringFormat;
+    QTextCharFormat commentFormat;
+    QTimer *highlightTimer;
+    int validUpTo = 0;  // blocks before this have an up to date end state
+    bool formatting = false;
+    std::vector<EditorDiagnostic> diagnostics;
+};
+
+// Editor tab: a CodeEditor plus syntax checking on a worker thread. Edits
+// are batched and, once typing pauses, replayed into an IncrementalDocument
+// on the worker, which re-lexes and re-parses only what they touched; its
+// diagnostics come back as underlines. The GUI thread never parses.
+class EditorTab : public QWidget {
+    Q_OBJECT
+
+public:
+    EditorTab(QWidget *parent = nullptr) : QWidget(parent) {
+        QVBoxLayout *layout = new QVBoxLayout(this);
+        
+        QHBoxLayout *fileLayout = new QHBoxLayout;
+        pathInput = new QLineEdit;
+        pathInput->setPlaceholderText("Path to a .npav file");
+        QPushButton *openButton = new QPushButton("Open...");
+        QPushButton *saveButton = new QPushButton("Save");
+        fileLayout->addWidget(pathInput);
+        fileLayout->addWidget(openButton);
+        fileLayout->addWidget(saveButton);
+        layout->addLayout(fileLayout);
+        
+        editor = new CodeEditor;
+        layout->addWidget(editor, 1);
+        statusLabel = new QLabel("No file open");
+        layout->addWidget(statusLabel);
+        
+        checkTimer = new QTimer(this);
+        checkTimer->setSingleShot(true);
+        checkTimer->setInterval(CHECK_DELAY_MS);
+        connect(checkTimer, &QTimer::timeout, this, &EditorTab::sendEdits);
+        connect(editor, &CodeEditor::textEdited, this, &EditorTab::recordEdit);
+        
+        connect(openButton, &QPushButton::clicked, this, [this]() {
+            QString path = QFileDialog::getOpenFileName(this, "Open NPAVC source", pathInput->text(),
+                                                        "NPAVC source (*.npav *.npavc);;All files (*)");
+            if (!path.isEmpty()) open(path);
+        });
+        connect(pathInput, &QLineEdit::returnPressed, this, [this]() { open(pathInput->text().trimmed()); });
+        connect(saveButton, &QPushButton::clicked, this, &EditorTab::save);
+        
+        checker = new QObject;
+        checker->moveToThread(&checkerThread);
+        connect(&checkerThread, &QThread::finished, checker, &QObject::deleteLater);
+        checkerThread.start();
+    }
+    
+    ~EditorTab() override {
+        checkerThread.quit();
+        checkerThread.wait();
+    }
+
+private slots:
+    void open(const QString &path) {
+        QFile file(path);
+        if (path.isEmpty() || !file.open(QIODevice::ReadOnly)) {
+            statusLabel->setText("Could not open " + path);
+            return;
+        }
+        pathInput->setText(path);
+        loading = true;
+        editor->setPlainText(QString::fromUtf8(file.readAll()));
+        loading = false;
+        editor->document()->setModified(false);
+        fullTextPending = true;
+        sendEdits();
+    }
+    
+    void save() {
+        QString path = pathInput->text().trimmed();
+        QFile file(path);
+        if (path.isEmpty() || !file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            statusLabel->setText("Could not write " + path);
+            return;
+        }
+        file.write(editor->toPlainText().toUtf8());
+        editor->document()->setModified(false);
+        statusLabel->setText("Saved " + path);
+    }
+    
+    // Keeps a byte-offset copy of each change for the checker. Offsets only
+    // match the document's UTF-16 positions for ASCII text, so anything else
+    // (or a change report that doesn't add up) resends the whole text.
+    void recordEdit(int position, int removed, int added) {
+        if (loading) return;
+        checkTimer->start();
+        if (fullTextPending) return;
+        qsizetype length = editor->document()->characterCount() - 1;
+        if (!asciiText || position + removed > checkedLength || checkedLength - removed + added != length) {
+            fullTextPending = true;
+            return;
+        }
+        QTextCursor cursor(editor->document());
+        cursor.setPosition(position);
+        cursor.setPosition(position + added, QTextCursor::KeepAnchor);
+        QString inserted = cursor.selectedText().replace(QChar::ParagraphSeparator, '\n');
+        QByteArray bytes = inserted.toUtf8();
+        if (bytes.size() != inserted.size()) {
+            asciiText = false;
+            fullTextPending = true;
+            return;
+        }
+        pendingEdits.push_back({static_cast<size_t>(position), static_cast<size_t>(position + removed), bytes.toStdString()});
+        checkedLength = length;
+    }
+    
+    void sendEdits() {
+        int generation = ++sentGeneration;
+        auto state = checkerState;
+        std::string fullText;
+        if (fullTextPending) {
+            QString text = editor->toPlainText();
+            fullText = text.toStdString();
+            asciiText = fullText.size() == static_cast<size_t>(text.size());
+            checkedLength = text.size();
+            pendingEdits.clear();
+        }
+        std::vector<PendingEdit> edits = std::move(pendingEdits);
+        pendingEdits.clear();
+        bool full = fullTextPending;
+        fullTextPending = false;
+        
+        QMetaObject::invokeMethod(checker, [this, state, generation, full, fullText, edits]() {
+            QElapsedTimer timer;
+            timer.start();
+            if (full) {
+                state->document.setText(fullText);
+            } else {
+                for (const PendingEdit &edit : edits) state->document.applyEdit(edit.start, edit.end, edit.replacement);
+            }
+            std::vector<EditorDiagnostic> found;
+            for (const Diagnostic &diagnostic : state->document.diagnostics()) {
+                found.push_back({diagnostic.line, diagnostic.column, QString::fromStdString(diagnostic.message)});
+            }
+            double seconds = timer.nsecsElapsed() / 1e9;
+            QMetaObject::invokeMethod(this, [this, generation, found, seconds]() {
+                showDiagnostics(generation, found, seconds);
+            }, Qt::QueuedConnection);
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    static const int CHECK_DELAY_MS = 150;
+    
+    struct PendingEdit {
+        size_t start;
+        size_t end;
+        std::string replacement;
+    };
+    
+    // Only touched on the checker thread
+    struct CheckerState {
+        IncrementalDocument document;
+    };
+    
+    // Results for text that has been edited since are dropped; newer ones are on the way
+    void showDiagnostics(int generation, const std::vector<EditorDiagnostic> &found, double seconds) {
+        if (generation != sentGeneration) return;
+        editor->setDiagnostics(found);
+        QString checked = QString("checked in %1 ms").arg(seconds * 1e3, 0, 'f', 1);
+        if (found.empty()) {
+            statusLabel->setText("No problems, " + checked);
+        } else {
+            statusLabel->setText(QString("%1 problem(s), %2 - line %3: %4").arg(found.size()).arg(checked)
+                                 .arg(found[0].line).arg(found[0].message));
+        }
+    }
+    
+    QLineEdit *pathInput;
+    CodeEditor *editor;
+    QLabel *statusLabel;
+    QTimer *checkTimer;
+    QThread checkerThread;
+    QObject *checker;  // lives on checkerThread; checks run in its event loop
+    std::shared_ptr<CheckerState> checkerState = std::make_shared<CheckerState>();
+    std::vector<PendingEdit> pendingEdits;
+    bool fullTextPending = true;
+    bool asciiText = true;
+    bool loading = false;
+    qsizetype checkedLength = 0;
+    int sentGeneration = 0;
+};
+
+// Interactive console on a ReplSession, the GUI side of `npavc --repl`: every
+// input runs in the same session, so variables and functions carry over from
+// one input to the next. The session lives on a worker thread, which keeps a
+// long-running input from freezing the window and lets Stop interrupt it.
+class ReplConsole : public QWidget {
+    Q_OBJECT
+
+public:
+    ReplConsole(QWidget *parent = nullptr) : QWidget(parent) {
+        QVBoxLayout *layout = new QVBoxLayout(this);
+        
+        outputArea = new QPlainTextEdit;
+        outputArea->setReadOnly(true);
+        outputArea->setMaximumBlockCount(MAX_SCROLLBACK_LINES);
+        outputArea->setUndoRedoEnabled(false);
+        outputArea->setFont(QFont("Consolas", 10));
+        outputArea->setStyleSheet("background-color: #1e1e1e; color: #ffffff; border: 1px solid #555;");
+        outputArea->setFocusPolicy(Qt::NoFocus);
+        outputArea->appendPlainText("Statements and functions entered here stay defined for the next input; "
+                                    "an expression on its own shows its value. :reset starts over.");
+        layout->addWidget(outputArea, 1);
+        
+        QHBoxLayout *inputLayout = new QHBoxLayout;
+        promptLabel = new QLabel(PROMPT);
+        promptLabel->setFont(QFont("Consolas", 10));
+        promptLabel->setStyleSheet("color: #00ff00; font-weight: bold;");
+        input = new QLineEdit;
+        input->setFont(QFont("Consolas", 10));
+        stopButton = new QPushButton("Stop");
+        stopButton->setFocusPolicy(Qt::NoFocus);
+        stopButton->setEnabled(false);
+        resetButton = new QPushButton("Reset");
+        resetButton->setFocusPolicy(Qt::NoFocus);
+        inputLayout->addWidget(promptLabel);
+        inputLayout->addWidget(input);
+        inputLayout->addWidget(stopButton);
+        inputLayout->addWidget(resetButton);
+        layout->addLayout(inputLayout);
+        
+        connect(input, &QLineEdit::returnPressed, this, &ReplConsole::submit);
+        connect(stopButton, &QPushButton::clicked, this, [this]() { state->cancelled = true; });
+        connect(resetButton, &QPushButton::clicked, this, &ReplConsole::resetSession);
+        
+        worker = new QObject;
+        worker->moveToThread(&workerThread);
+        connect(&workerThread, &QThread::finished, worker, &QObject::deleteLater);
+        workerThread.start();
+    }
+    
+    ~ReplConsole() override {
+        state->cancelled = true;
+        workerThread.quit();
+        workerThread.wait();
+    }
+
+protected:
+    void showEvent(QShowEvent *event) override {
+        QWidget::showEvent(event);
+        input->setFocus();
+    }
+
+private slots:
+    // Collects lines until the input is complete (no bracket, comment or
+    // string left open), then runs them as one chunk
+    void submit() {
+        QString line = input->text();
+        input->clear();
+        appendLine(QString(pending.empty() ? PROMPT : CONTINUATION_PROMPT) + " " + line);
+        if (pending.empty() && line.trimmed() == ":reset") {
+            resetSession();
+            return;
+        }
+        pending += line.toStdString() + "\n";
+        if (!ReplSession::isComplete(pending)) {
+            promptLabel->setText(CONTINUATION_PROMPT);
+            return;
+        }
+        run(pending);
+        pending.clear();
+        promptLabel->setText(PROMPT);
+    }
+    
+    void resetSession() {
+        pending.clear();
+        promptLabel->setText(PROMPT);
+        auto state = this->state;
+        QMetaObject::invokeMethod(worker, [state]() { state->session.reset(); }, Qt::QueuedConnection);
+        appendLine("Session reset");
+    }
+
+private:
+    static constexpr const char *PROMPT = "npav>";
+    static constexpr const char *CONTINUATION_PROMPT = "...>";
+    static const int MAX_SCROLLBACK_LINES = 10000;
+    
+    // Only touched on the worker thread, apart from the cancel flag
+    struct SessionState {
+        std::atomic<bool> cancelled{false};
+        ReplSession session;
+        
+        SessionState() : session(cancellable(cancelled)) {}
+        
+        static RunOptions cancellable(const std::atomic<bool> &flag) {
+            RunOptions options;
+            options.cancel = &flag;
+            return options;
+        }
+    };
+    
+    void run(const std::string &chunk) {
+        input->setEnabled(false);
+        resetButton->setEnabled(false);
+        stopButton->setEnabled(true);
+        state->cancelled = false;
+        auto state = this->state;
+        QMetaObject::invokeMethod(worker, [this, state, chunk]() {
+            auto show = [this](const QString &text, bool endsLine) {
+                QMetaObject::invokeMethod(this, [this, text, endsLine]() { appendOutput(text, endsLine); },
+                                          Qt::QueuedConnection);
+            };
+            LineStreamBuf outBuf(show);
+            LineStreamBuf errBuf(show);
+            std::ostream out(&outBuf);
+            std::ostream errors(&errBuf);
+            state->session.execute(chunk, out, errors);
+            outBuf.finish();
+            errBuf.finish();
+            QMetaObject::invokeMethod(this, [this]() { chunkFinished(); }, Qt::QueuedConnection);
+        }, Qt::QueuedConnection);
+    }
+    
+    // Program output as written: text continues a line the program left
+    // unfinished, and only the line breaks it printed start new ones
+    void appendOutput(const QString &text, bool endsLine) {
+        if (lineOpen) {
+            QTextCursor cursor(outputArea->document());
+            cursor.movePosition(QTextCursor::End);
+            cursor.insertText(text);
+            outputArea->verticalScrollBar()->setValue(outputArea->verticalScrollBar()->maximum());
+        } else {
+            outputArea->appendPlainText(text);
+        }
+        lineOpen = !endsLine;
+    }
+    
+    // A line of the console's own (echoed input, notices) always starts a new line
+    void appendLine(const QString &text) {
+        outputArea->appendPlainText(text);
+        lineOpen = false;
+    }
+    
+    void chunkFinished() {
+        stopButton->setEnabled(false);
+        resetButton->setEnabled(true);
+        input->setEnabled(true);
+        input->setFocus();
+    }
+    
+    QPlainTextEdit *outputArea;
+    QLabel *promptLabel;
+    QLineEdit *input;
+    QPushButton *stopButton;
+    QPushButton *resetButton;
+    QThread workerThread;
+    QObject *worker;  // lives on workerThread; inputs run in its event loop
+    std::shared_ptr<SessionState> state = std::make_shared<SessionState>();
+    std::string pending;  // lines of an input that isn't complete yet
+    bool lineOpen = false;  // the last output line has no line break yet
+};
+
+// A tab page whose real content is only built the first time it is needed,
+// which keeps startup down to the widgets the first tab shows
+class LazyTab : public QWidget {
+    Q_OBJECT
+
+public:
+    explicit LazyTab(std::function<QWidget *()> factory, QWidget *parent = nullptr)
+        : QWidget(parent), factory(std::move(factory)) {
+        QVBoxLayout *layout = new QVBoxLayout(this);
+        layout->setContentsMargins(0, 0, 0, 0);
+    }
+    
+    QWidget *content() {
+        if (!widget) {
+            widget = factory();
+            factory = nullptr;
+            layout()->addWidget(widget);
+        }
+        return widget;
+    }
+
+private:
+    std::function<QWidget *()> factory;
+    QWidget *widget = nullptr;
+};
+
 class MainWindow : public QMainWindow {
     Q_OBJECT
 
@@ -609,13 +2653,9 @@ public:
 
 private slots:
     void onTabChanged(int index) {
-        // When switching to shell tab, ensure it gets focus
-        if (index == 0) { // Shell tab
-            QTimer::singleShot(50, this, [this]() {
-                if (shellEmulator) {
-                    shellEmulator->setFocus();
-                }
-            });
+        // Tabs other than the shell are built the first time they are shown
+        if (LazyTab *tab = qobject_cast<LazyTab *>(tabWidget->widget(index))) {
+            tab->content();
         }
     }
 
@@ -634,23 +2674,47 @@ private:
         mainLayout->addWidget(titleLabel);
         
         // Create tab widget
-        QTabWidget *tabWidget = new QTabWidget;
-        connect(tabWidget, &QTabWidget::currentChanged, this, &MainWindow::onTabChanged);
+        tabWidget = new QTabWidget;
         
         // Shell tab
         shellEmulator = new ShellEmulator;
         tabWidget->addTab(shellEmulator, "Shell Emulator");
         
+        // Editor tab
+        tabWidget->addTab(new LazyTab([]() { return new EditorTab; }), "Editor");
+        
+        // Interactive session that keeps its variables between inputs
+        tabWidget->addTab(new LazyTab([]() { return new ReplConsole; }), "Console");
+        
         // Explanation tab
-        CompilerExplanation *explanation = new CompilerExplanation;
-        tabWidget->addTab(explanation, "How It Works");
+        tabWidget->addTab(new LazyTab([]() { return new CompilerExplanation; }), "How It Works");
         
         // Flowchart tab
-        FlowchartWidget *flowchart = new FlowchartWidget;
-        QScrollArea *flowchartScroll = new QScrollArea;
-        flowchartScroll->setWidget(flowchart);
-        flowchartScroll->setWidgetResizable(true);
-        tabWidget->addTab(flowchartScroll, "Process Flow");
+        flowchartTab = new LazyTab([this]() {
+            flowchart = new FlowchartWidget;
+            QScrollArea *flowchartScroll = new QScrollArea;
+            flowchartScroll->setWidget(flowchart);
+            flowchartScroll->setWidgetResizable(true);
+            return flowchartScroll;
+        });
+        tabWidget->addTab(flowchartTab, "Process Flow");
+        
+        // Token and syntax tree explorer
+        tabWidget->addTab(new LazyTab([]() { return new ProgramExplorer; }), "Explorer");
+        
+        connect(tabWidget, &QTabWidget::currentChanged, this, &MainWindow::onTabChanged);
+        
+        // The diagram follows the newest npavc run, so the first run builds
+        // it even if the tab hasn't been opened yet
+        connect(shellEmulator, &ShellEmulator::npavcStarted, this, [this](NpavcRunner *runner, bool compile) {
+            flowchartTab->content();
+            if (followedRunner) followedRunner->disconnect(flowchart);
+            followedRunner = runner;
+            flowchart->runStarted(compile);
+            connect(runner, &NpavcRunner::phaseStarted, flowchart, &FlowchartWidget::phaseStarted);
+            connect(runner, &NpavcRunner::phaseFinished, flowchart, &FlowchartWidget::phaseFinished);
+            connect(runner, &NpavcRunner::finished, flowchart, &FlowchartWidget::runFinished);
+        });
         
         mainLayout->addWidget(tabWidget);
         
@@ -658,15 +2722,62 @@ private:
         statusBar()->showMessage("Ready - Use the Shell tab to run NPAVC commands");
     }
     
+    QTabWidget *tabWidget;
     ShellEmulator *shellEmulator;
+    LazyTab *flowchartTab;
+    FlowchartWidget *flowchart = nullptr;  // inside flowchartTab, once built
+    QPointer<NpavcRunner> followedRunner;
+};
+
+// Calls back once, after the first paint event of the watched widget
+class FirstPaintWatcher : public QObject {
+    Q_OBJECT
+
+public:
+    FirstPaintWatcher(QWidget *widget, std::function<void()> painted)
+        : QObject(widget), painted(std::move(painted)) {
+        widget->installEventFilter(this);
+    }
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override {
+        if (event->type() == QEvent::Paint && painted) {
+            watched->removeEventFilter(this);
+            // Report once this paint (and the rest of the frame) is done
+            QTimer::singleShot(0, this, painted);
+            painted = nullptr;
+        }
+        return false;
+    }
+
+private:
+    std::function<void()> painted;
 };
 
 #include "npavGui.moc"
 
 int main(int argc, char *argv[]) {
+    QElapsedTimer startup;
+    startup.start();
     QApplication app(argc, argv);
+    qint64 appCreated = startup.nsecsElapsed();
+    
+    // --startup-time prints how long startup took to stderr; --startup-time=exit
+    // also quits once the first frame is drawn, for timing launches in a loop
+    QString startupTime;
+    for (const QString &arg : app.arguments()) {
+        if (arg == "--startup-time" || arg == "--startup-time=exit") startupTime = arg;
+    }
     
     MainWindow window;
+    qint64 windowBuilt = startup.nsecsElapsed();
+    if (!startupTime.isEmpty()) {
+        new FirstPaintWatcher(window.centralWidget(), [&]() {
+            std::fprintf(stderr, "Startup: QApplication %.1f ms, main window %.1f ms, first frame %.1f ms\n",
+                         appCreated / 1e6, windowBuilt / 1e6, startup.nsecsElapsed() / 1e6);
+            if (startupTime == "--startup-time=exit") app.quit();
+        });
+    }
     window.show();
     
     return app.exec();
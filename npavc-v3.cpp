@@ -1,959 +1,434 @@
 #include <iostream>
 #include <string>
-#include <vector>
-#include <cctype>
-#include <stdexcept>
 #include <fstream>
 #include <sstream>
-#include <map>
-#include <cstdlib>
-#include <filesystem>
-// Token types for our language
-enum TokenType {
-    VOID, MAIN, LPAREN, RPAREN, LBRACE, RBRACE,
-    NUMBER, PLUS, MINUS, MULTIPLY, DIVIDE, SEMICOLON,
-    IDENTIFIER, COMMA, STRING, ASSIGN, INT,
-    IF, ELSE, WHILE, FOR, RETURN, LBRACKET, RBRACKET,
-    EQUAL, NOT_EQUAL, LESS_THAN, GREATER_THAN, LESS_THAN_OR_EQUAL, GREATER_THAN_OR_EQUAL,
-    EOF_TOKEN, UNKNOWN
-};
+#include <new>
+#include <charconv>
+#include <cstring>
+#include "npavc_core.h"
 
-// Token structure
-struct Token {
-    TokenType type;
-    std::string value;
-    int line;
-    int column;
-    
-    Token(TokenType t, const std::string& v, int l, int c) 
-        : type(t), value(v), line(l), column(c) {}
-};
+#ifdef _WIN32
+#include <io.h>
+#define isatty _isatty
+#define STDIN_FILENO 0
+#else
+#include <unistd.h>
+#endif
 
-// Lexer class - converts source code into tokens
-class Lexer {
-private:
-    std::string source;
-    size_t pos;
-    int line;
-    int column;
-    
-    char currentChar() {
-        if (pos >= source.length()) return '\0';
-        return source[pos];
+#ifdef __linux__
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <thread>
+#endif
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+
+// Heap accounting for --time-report. The global operator new/delete keep a
+// running total while tracking is on, using the allocator's own block sizes
+// so nothing has to be stored alongside each allocation. Tracking is only on
+// while the timed phases run: a block allocated before it started would
+// otherwise be subtracted when freed, skewing (even negating) the total.
+static bool trackHeap = false;
+static long long heapBytes = 0;
+static long long heapPeak = 0;
+
+void* operator new(size_t size) {
+    void* block = malloc(size ? size : 1);
+    if (!block) throw std::bad_alloc();
+    if (trackHeap) {
+        heapBytes += malloc_usable_size(block);
+        if (heapBytes > heapPeak) heapPeak = heapBytes;
+    }
+    return block;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* block) noexcept {
+    if (block && trackHeap) heapBytes -= malloc_usable_size(block);
+    free(block);
+}
+
+void operator delete[](void* block) noexcept {
+    operator delete(block);
+}
+
+// The sized forms must free through the same path, or they would hand
+// malloc'ed blocks to the library's own operator delete
+void operator delete(void* block, size_t) noexcept {
+    operator delete(block);
+}
+
+void operator delete[](void* block, size_t) noexcept {
+    operator delete(block);
+}
+
+static void trackHeapIn(TimeReport& report) {
+    report.currentBytes = []() { return heapBytes; };
+    report.peakBytes = []() { return heapPeak; };
+    report.resetPeak = []() { heapPeak = heapBytes; };
+}
+
+static void setHeapTracking(bool enabled) {
+    trackHeap = enabled;
+}
+#else
+static void trackHeapIn(TimeReport&) {}
+static void setHeapTracking(bool) {}
+#endif
+
+// Reads a whole source file, giving every line (the last one too) a newline
+static bool readSource(const std::string& filename, std::string& sourceCode) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        return false;
     }
-    
-    char peekChar() {
-        if (pos + 1 >= source.length()) return '\0';
-        return source[pos + 1];
+    sourceCode.clear();
+    std::string line;
+    while (std::getline(file, line)) {
+        sourceCode += line + "\n";
     }
+    return true;
+}
+
+// Parses the value of --max-stack/--max-depth: digits only, within size_t
+static bool parseLimit(const char* text, size_t& limit) {
+    const char* end = text + std::strlen(text);
+    auto [stop, failure] = std::from_chars(text, end, limit);
+    return failure == std::errc() && stop == end && stop != text;
+}
+
+#ifdef __linux__
+// inotify watches for a set of files. The directories are watched rather
+// than the files themselves: many editors save by writing a new file and
+// renaming it over the old one, which would silently end a watch on the file.
+class FileWatches {
+public:
+    static const uint32_t EVENTS = IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE;
     
-    void advance() {
-        if (pos < source.length()) {
-            if (source[pos] == '\n') {
-                line++;
-                column = 1;
-            } else {
-                column++;
-            }
-            pos++;
-        }
-    }
+    FileWatches() : fd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) {}
     
-    void skipWhitespace() {
-        while (isspace(currentChar())) {
-            advance();
-        }
-    }
-    void skipComment() {
-	    if (currentChar() == '/' && peekChar() == '/') {
-		    while (currentChar() != '\n' && currentChar() != '\0') {
-			    advance();
-		    }
-	    }
-	    else if (currentChar() == '/' && peekChar() == '*') {
-		    advance();
-		    advance();
-		    while (currentChar() != '\0') {
-			    if (currentChar() == '*' && peekChar() == '/') {
-				    advance();
-				    advance();
-				    break;
-			    }
-			    advance();
-		    }
-	    }
-    }
-
-    Token makeNumber() {
-        std::string num;
-        int startCol = column;
-        
-        while (isdigit(currentChar())) {
-            num += currentChar();
-            advance();
-        }
-        
-        return Token(NUMBER, num, line, startCol);
+    ~FileWatches() {
+        if (fd >= 0) close(fd);
     }
     
-    Token makeString() {
-        std::string str;
-        int startCol = column;
-        
-        advance(); // Skip opening quote
-        
-        while (currentChar() != '"' && currentChar() != '\0') {
-            if (currentChar() == '\\') {
-                advance(); // Skip backslash
-                char escaped = currentChar();
-                switch (escaped) {
-                    case 'n': str += '\n'; break;
-                    case 't': str += '\t'; break;
-                    case 'r': str += '\r'; break;
-                    case '\\': str += '\\'; break;
-                    case '"': str += '"'; break;
-                    default: 
-                        str += '\\';
-                        str += escaped;
-                        break;
-                }
-                advance();
-            } else {
-                str += currentChar();
-                advance();
+    bool ok() const { return fd >= 0; }
+    
+    // Replaces the watched files; directories that can't be watched are skipped
+    void watch(const std::vector<std::string>& paths) {
+        files.clear();
+        for (const auto& path : paths) {
+            std::string file = key(path);
+            std::string directory = std::filesystem::path(file).parent_path().string();
+            if (!watchedDirectories.count(directory)) {
+                int wd = inotify_add_watch(fd, directory.c_str(), EVENTS);
+                if (wd < 0) continue;
+                directories[wd] = directory;
+                watchedDirectories.insert(directory);
             }
+            files.insert(file);
         }
-        
-        if (currentChar() == '"') {
-            advance(); // Skip closing quote
-        } else {
-            throw std::runtime_error("Unterminated string literal at line " + std::to_string(line));
-        }
-        
-        return Token(STRING, str, line, startCol);
     }
     
-    Token makeIdentifier() {
-        std::string id;
-        int startCol = column;
-        
-        while (isalnum(currentChar()) || currentChar() == '_') {
-            id += currentChar();
-            advance();
+    // Waits up to timeoutMs (-1: forever) for events, and adds the watched
+    // files they touched to changed. Returns false on timeout.
+    bool wait(int timeoutMs, std::set<std::string>& changed) {
+        pollfd ready{fd, POLLIN, 0};
+        if (poll(&ready, 1, timeoutMs) <= 0) {
+            return false;
         }
-        
-        // Check for keywords
-        if (id == "void") return Token(VOID, id, line, startCol);
-        if (id == "main") return Token(MAIN, id, line, startCol);
-        if (id == "int") return Token(INT, id, line, startCol);
-        if (id == "if") return Token(IF, id, line, startCol);
-        if (id == "else") return Token(ELSE, id, line, startCol);
-        if (id == "while") return Token(WHILE, id, line, startCol);
-        if (id == "for") return Token(FOR, id, line, startCol);
-        if (id == "return") return Token(RETURN, id, line, startCol);
-        
-        return Token(IDENTIFIER, id, line, startCol);
-    }
-    
-public:
-    Lexer(const std::string& src) : source(src), pos(0), line(1), column(1) {}
-    
-    std::vector<Token> tokenize() {
-        std::vector<Token> tokens;
-        
-        while (currentChar() != '\0') {
-            skipWhitespace();
-            
-            if (currentChar() == '\0') break;
-            
-            char ch = currentChar();
-            int startCol = column;
-            
-            if (isdigit(ch)) {
-                tokens.push_back(makeNumber());
-            } else if (ch == '"') {
-                tokens.push_back(makeString());
-            } else if (isalpha(ch) || ch == '_') {
-                tokens.push_back(makeIdentifier());
-            } else {
-                switch (ch) {
-                    case '(': tokens.push_back(Token(LPAREN, "(", line, startCol)); advance(); break;
-                    case ')': tokens.push_back(Token(RPAREN, ")", line, startCol)); advance(); break;
-                    case '{': tokens.push_back(Token(LBRACE, "{", line, startCol)); advance(); break;
-                    case '}': tokens.push_back(Token(RBRACE, "}", line, startCol)); advance(); break;
-                    case '[': tokens.push_back(Token(LBRACKET, "[", line, startCol)); advance(); break;
-                    case ']': tokens.push_back(Token(RBRACKET, "]", line, startCol)); advance(); break;
-                    case '+': tokens.push_back(Token(PLUS, "+", line, startCol)); advance(); break;
-                    case '-': tokens.push_back(Token(MINUS, "-", line, startCol)); advance(); break;
-                    case '*': tokens.push_back(Token(MULTIPLY, "*", line, startCol)); advance(); break;
-                    case '/': 
-			      if (peekChar() == '/' || peekChar() == '*') {
-				      skipComment();
-				      break;
-			      }
-			      else {
-			      	tokens.push_back(Token(DIVIDE, "/", line, startCol)); advance(); break;
-			      }
-                    case ';': tokens.push_back(Token(SEMICOLON, ";", line, startCol)); advance(); break;
-                    case ',': tokens.push_back(Token(COMMA, ",", line, startCol)); advance(); break;
-                    case '=':
-                        if (peekChar() == '=') {
-                            tokens.push_back(Token(EQUAL, "==", line, startCol));
-                            advance(); advance();
-                        } else {
-                            tokens.push_back(Token(ASSIGN, "=", line, startCol));
-                            advance();
-                        }
-                        break;
-                    case '!':
-                        if (peekChar() == '=') {
-                            tokens.push_back(Token(NOT_EQUAL, "!=", line, startCol));
-                            advance(); advance();
-                        } else {
-                            std::cout << "Warning: Unknown character '" << ch << "' at line " 
-                                      << line << ", column " << column << std::endl;
-                            advance();
-                        }
-                        break;
-                    case '<': 
-			if (peekChar() == '=') {
-				tokens.push_back(Token(LESS_THAN_OR_EQUAL, "<=", line, startCol));
-				advance(); advance();
-			}
-			else {
-				tokens.push_back(Token(LESS_THAN, "<", line, startCol));
-				advance();
-			}
-			break;
-                    case '>': 
-			      if (peekChar() == '=') {
-				      tokens.push_back(Token(GREATER_THAN_OR_EQUAL, ">=", line, startCol));
-				      advance(); advance();
-			      }
-			      else {
-				      tokens.push_back(Token(GREATER_THAN, ">", line, startCol));
-				      advance();
-			      }
-			      break;
-			      
-		    default:
-                        std::cout << "Warning: Unknown character '" << ch << "' at line " 
-                                  << line << ", column " << column << std::endl;
-                        advance();
-                        break;
-                }
+        alignas(inotify_event) char buffer[4096];
+        ssize_t length;
+        while ((length = read(fd, buffer, sizeof(buffer))) > 0) {
+            for (char* at = buffer; at < buffer + length;) {
+                auto* event = reinterpret_cast<inotify_event*>(at);
+                at += sizeof(inotify_event) + event->len;
+                auto directory = directories.find(event->wd);
+                if (event->len == 0 || directory == directories.end()) continue;
+                std::string path = (std::filesystem::path(directory->second) / event->name).string();
+                if (files.count(path)) changed.insert(path);
             }
         }
-        
-        tokens.push_back(Token(EOF_TOKEN, "", line, column));
-        return tokens;
+        return true;
     }
-};
-
-// AST Node types
-enum NodeType {
-    PROGRAM_NODE, MAIN_FUNCTION_NODE, ARITHMETIC_NODE, NUMBER_NODE, 
-    FUNCTION_CALL_NODE, STRING_NODE, VARIABLE_NODE, ASSIGNMENT_NODE,
-    IF_NODE, WHILE_NODE, COMPARISON_NODE, BLOCK_NODE, RETURN_NODE,
-    FUNCTION_DEF_NODE, VARIABLE_DECL_NODE
-};
-
-// Base AST Node
-struct ASTNode {
-    NodeType type;
-    std::vector<ASTNode*> children;
-    std::string value;
     
-    ASTNode(NodeType t, const std::string& v = "") : type(t), value(v) {}
-    
-    ~ASTNode() {
-        for (auto child : children) {
-            delete child;
-        }
+    // How wait() reports a watched path: its directory (. if none) joined with its name
+    static std::string key(const std::string& path) {
+        std::filesystem::path normal = std::filesystem::path(path).lexically_normal();
+        return (std::filesystem::path(normal.has_parent_path() ? normal.parent_path().string() : ".") /
+                normal.filename()).string();
     }
-};
 
-// Parser class
-class Parser {
 private:
-    std::vector<Token> tokens;
-    size_t pos;
-    
-    Token& currentToken() {
-        if (pos >= tokens.size()) {
-            static Token eofToken(EOF_TOKEN, "", 0, 0);
-            return eofToken;
-        }
-        return tokens[pos];
-    }
-    
-    void advance() {
-        if (pos < tokens.size()) pos++;
+    int fd;
+    std::map<int, std::string> directories;
+    std::set<std::string> watchedDirectories;
+    std::set<std::string> files;
+};
+
+// `npavc <file> --watch [-c]`: builds once, then again whenever the file or
+// a file it compile()s changes. A burst of writes (an editor saving in
+// several steps) is waited out before rebuilding; a save that leaves the
+// text as it was is ignored; and a change during a long run interrupts it
+// and starts over. Each build runs on its own thread so the watch goes on.
+static int runWatch(const std::string& filename, bool compile, const std::string& outputName, RunOptions options) {
+    const int DEBOUNCE_MS = 100;
+    FileWatches watches;
+    if (!watches.ok()) {
+        std::cerr << "Error: Could not start watching files: " << std::strerror(errno) << std::endl;
+        return 1;
     }
-    
-    void expect(TokenType type) {
-        if (currentToken().type != type) {
-            throw std::runtime_error("Expected token type " + std::to_string(type) + 
-                                     " but got " + std::to_string(currentToken().type));
+    std::atomic<bool> cancel{false};
+    options.cancel = &cancel;
+    WatchedProgram program(filename, compile, outputName, options);
+    std::string builtSource;
+    std::vector<std::string> references;
+    std::thread build;
+    std::atomic<bool> buildDone{false};
+    
+    auto startBuild = [&](const std::string& source) {
+        builtSource = source;
+        cancel = false;
+        buildDone = false;
+        build = std::thread([&, source]() {
+            auto begin = std::chrono::steady_clock::now();
+            if (!compile) {
+                std::cout << "Interpreting file: " << filename << std::endl;
+            }
+            int result = program.rebuild(source, std::cout, std::cerr);
+            references = program.references();
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+            char elapsed[32];
+            std::snprintf(elapsed, sizeof(elapsed), "%.1f ms", ms);
+            std::cout.flush();
+            std::cerr << "[watch] " << (result == 0 ? "Done" : "Failed") << " in " << elapsed
+                      << ", waiting for changes to " << filename << std::endl;
+            buildDone = true;
+        });
+    };
+    auto finishBuild = [&]() {
+        if (build.joinable()) {
+            build.join();
+            std::vector<std::string> paths{filename};
+            paths.insert(paths.end(), references.begin(), references.end());
+            watches.watch(paths);
         }
-        advance();
-    }
+    };
     
-    ASTNode* parseExpression() {
-        return parseComparison();
+    std::string source;
+    if (!readSource(filename, source)) {
+        std::cerr << "Error: Could not open file '" << filename << "'" << std::endl;
+        return 1;
     }
-    
-    ASTNode* parseComparison() {
-        ASTNode* left = parseAddition();
-        
-        while (currentToken().type == EQUAL || currentToken().type == NOT_EQUAL ||
-               currentToken().type == LESS_THAN || currentToken().type == GREATER_THAN ||
-	       currentToken().type == LESS_THAN_OR_EQUAL || currentToken().type == GREATER_THAN_OR_EQUAL) {
-            Token op = currentToken();
-            advance();
-            ASTNode* right = parseAddition();
-            
-            ASTNode* node = new ASTNode(COMPARISON_NODE, op.value);
-            node->children.push_back(left);
-            node->children.push_back(right);
-            left = node;
+    watches.watch({filename});
+    startBuild(source);
+    std::string mainKey = FileWatches::key(filename);
+    while (true) {
+        if (buildDone) {
+            finishBuild();
         }
-        
-        return left;
-    }
-    
-    ASTNode* parseAddition() {
-        ASTNode* left = parseMultiplication();
-        
-        while (currentToken().type == PLUS || currentToken().type == MINUS) {
-            Token op = currentToken();
-            advance();
-            ASTNode* right = parseMultiplication();
-            
-            ASTNode* node = new ASTNode(ARITHMETIC_NODE, op.value);
-            node->children.push_back(left);
-            node->children.push_back(right);
-            left = node;
+        // While a build runs, wake up now and then to pick up the files it compile()s
+        std::set<std::string> changed;
+        if (!watches.wait(build.joinable() ? DEBOUNCE_MS : -1, changed) || changed.empty()) {
+            continue;
         }
+        while (watches.wait(DEBOUNCE_MS, changed)) {}
         
-        return left;
-    }
-    
-    ASTNode* parseMultiplication() {
-        ASTNode* left = parsePrimary();
-        
-        while (currentToken().type == MULTIPLY || currentToken().type == DIVIDE) {
-            Token op = currentToken();
-            advance();
-            ASTNode* right = parsePrimary();
-            
-            ASTNode* node = new ASTNode(ARITHMETIC_NODE, op.value);
-            node->children.push_back(left);
-            node->children.push_back(right);
-            left = node;
+        if (!readSource(filename, source)) {
+            // Mid-save (deleted before the new version was moved in); the next event brings it back
+            continue;
         }
-        
-        return left;
-    }
-    
-    ASTNode* parsePrimary() {
-        if (currentToken().type == NUMBER) {
-            ASTNode* node = new ASTNode(NUMBER_NODE, currentToken().value);
-            advance();
-            return node;
-        } else if (currentToken().type == STRING) {
-            ASTNode* node = new ASTNode(STRING_NODE, currentToken().value);
-            advance();
-            return node;
-        } else if (currentToken().type == IDENTIFIER) {
-            std::string name = currentToken().value;
-            advance();
-            
-            if (currentToken().type == LPAREN) {
-                // Function call
-                advance(); // consume '('
-                
-                ASTNode* funcCall = new ASTNode(FUNCTION_CALL_NODE, name);
-                
-                if (currentToken().type != RPAREN) {
-                    do {
-                        ASTNode* arg = parseExpression();
-                        funcCall->children.push_back(arg);
-                        
-                        if (currentToken().type == COMMA) {
-                            advance();
-                        } else {
-                            break;
-                        }
-                    } while (currentToken().type != RPAREN);
-                }
-                
-                expect(RPAREN);
-                return funcCall;
-            } else {
-                // Variable reference
-                return new ASTNode(VARIABLE_NODE, name);
-            }
-        } else if (currentToken().type == LPAREN) {
-            advance(); // consume '('
-            ASTNode* node = parseExpression();
-            expect(RPAREN);
-            return node;
-        } else {
-            throw std::runtime_error("Expected number, string, identifier, or '(' at line " + 
-                                     std::to_string(currentToken().line));
+        bool referenceChanged = changed.size() > 1 || !changed.count(mainKey);
+        if (!referenceChanged && source == builtSource) {
+            continue;
         }
-    }
-    
-    ASTNode* parseStatement() {
-        if (currentToken().type == INT) {
-            // Variable declaration
-            advance(); // consume 'int'
-            std::string varName = currentToken().value;
-            expect(IDENTIFIER);
-            
-            ASTNode* varDecl = new ASTNode(VARIABLE_DECL_NODE, varName);
-            
-            if (currentToken().type == ASSIGN) {
-                advance(); // consume '='
-                ASTNode* value = parseExpression();
-                varDecl->children.push_back(value);
-            }
-            
-            expect(SEMICOLON);
-            return varDecl;
-        } else if (currentToken().type == IDENTIFIER) {
-            // Assignment or expression
-            std::string name = currentToken().value;
-            advance();
-            
-            if (currentToken().type == ASSIGN) {
-                advance(); // consume '='
-                ASTNode* value = parseExpression();
-                expect(SEMICOLON);
-                
-                ASTNode* assignment = new ASTNode(ASSIGNMENT_NODE, name);
-                assignment->children.push_back(value);
-                return assignment;
-            } else {
-                // Put the identifier back for expression parsing
-                pos--;
-                ASTNode* expr = parseExpression();
-                expect(SEMICOLON);
-                return expr;
-            }
-        } else if (currentToken().type == IF) {
-            advance(); // consume 'if'
-            expect(LPAREN);
-            ASTNode* condition = parseExpression();
-            expect(RPAREN);
-            
-            ASTNode* thenStmt = parseStatement();
-            
-            ASTNode* ifNode = new ASTNode(IF_NODE);
-            ifNode->children.push_back(condition);
-            ifNode->children.push_back(thenStmt);
-            
-            if (currentToken().type == ELSE) {
-                advance(); // consume 'else'
-                ASTNode* elseStmt = parseStatement();
-                ifNode->children.push_back(elseStmt);
-            }
-            
-            return ifNode;
-        } else if (currentToken().type == WHILE) {
-            advance(); // consume 'while'
-            expect(LPAREN);
-            ASTNode* condition = parseExpression();
-            expect(RPAREN);
-            ASTNode* body = parseStatement();
-            
-            ASTNode* whileNode = new ASTNode(WHILE_NODE);
-            whileNode->children.push_back(condition);
-            whileNode->children.push_back(body);
-            return whileNode;
-        } else if (currentToken().type == LBRACE) {
-            // Block
-            advance(); // consume '{'
-            ASTNode* block = new ASTNode(BLOCK_NODE);
-            
-            while (currentToken().type != RBRACE && currentToken().type != EOF_TOKEN) {
-                ASTNode* stmt = parseStatement();
-                block->children.push_back(stmt);
-            }
-            
-            expect(RBRACE);
-            return block;
-        } else if (currentToken().type == RETURN) {
-            advance(); // consume 'return'
-            ASTNode* returnNode = new ASTNode(RETURN_NODE);
-            
-            if (currentToken().type != SEMICOLON) {
-                ASTNode* value = parseExpression();
-                returnNode->children.push_back(value);
-            }
-            
-            expect(SEMICOLON);
-            return returnNode;
-        } else {
-            // Expression statement
-            ASTNode* expr = parseExpression();
-            expect(SEMICOLON);
-            return expr;
+        if (build.joinable()) {
+            cancel = true;
+            finishBuild();
         }
-    }
-    
-public:
-    Parser(const std::vector<Token>& toks) : tokens(toks), pos(0) {}
-    
-    ASTNode* parse() {
-        ASTNode* program = new ASTNode(PROGRAM_NODE);
-        
-	if (currentToken().type != VOID) {
-            throw std::runtime_error("Error: couldn't find main function. Make sure to define it as void main() {");
-        }
-
-        // Parse: void main() { ... }
-        expect(VOID);
-        expect(MAIN);
-        expect(LPAREN);
-        expect(RPAREN);
-        expect(LBRACE);
-        
-        ASTNode* mainFunc = new ASTNode(MAIN_FUNCTION_NODE);
-        
-        while (currentToken().type != RBRACE && currentToken().type != EOF_TOKEN) {
-            ASTNode* stmt = parseStatement();
-            mainFunc->children.push_back(stmt);
+        std::cerr << "[watch] Rebuilding, changed: ";
+        for (auto path = changed.begin(); path != changed.end(); ++path) {
+            std::cerr << (path == changed.begin() ? "" : ", ") << *path;
         }
-        
-        expect(RBRACE);
-        program->children.push_back(mainFunc);
-        
-        return program;
+        std::cerr << std::endl;
+        startBuild(source);
     }
-};
-
-// Value type for evaluator
-struct Value {
-    enum Type { INT, STRING } type;
-    int intValue = 0;
-    std::string stringValue;
-    bool uninitWarn = false;
-    Value(int i) : type(INT), intValue(i) {}
-    Value(const std::string& s) : type(STRING), stringValue(s) {}
+}
+#else
+static int runWatch(const std::string&, bool, const std::string&, RunOptions) {
+    std::cerr << "Error: --watch needs inotify and is only available on Linux" << std::endl;
+    return 1;
+}
+#endif
 
-    Value(ASTNode* n) {
-        switch (n->type) {
-            case NUMBER_NODE:
-                type = INT;
-                intValue = std::stoi(n->value);  // convert from string to int
-                break;
-            case STRING_NODE:
-                type = STRING;
-                stringValue = n->value;
-                break;
-            default:
-                throw std::runtime_error("ASTNode type not convertible to Value");
-        }
-    }
-    Value() {
-	    type=INT;
-	    intValue = 0;
-	    // std::cerr << "Warning: variable '" << node->value << "' declared without init (default to 0)\n";
+// `npavc --repl`: reads statements from stdin and runs each as soon as it is
+// complete, in one session that keeps its variables and functions. Prompts
+// only when stdin is a terminal; piped input exits with 1 if the last chunk failed.
+static int runRepl(const RunOptions& options) {
+    ReplSession session(options);
+    bool interactive = isatty(STDIN_FILENO);
+    bool ok = true;
+    std::string chunk;
+    std::string line;
+    if (interactive) {
+        std::cout << "npav session - :help for commands" << std::endl;
     }
-};
-
-
-// Evaluator class
-class Evaluator {
-private:
-    std::map<std::string, Value> variables;
-    
-public:
-    Value evaluate(ASTNode* node) {
-        switch (node->type) {
-            case PROGRAM_NODE: {
-                if (!node->children.empty()) {
-                    return evaluate(node->children[0]);
-                }
-                return Value(0);
-            }
-                
-            case MAIN_FUNCTION_NODE: {
-                Value result(0);
-                for (auto child : node->children) {
-                    result = evaluate(child);
-                }
-                return result;
-            }
-            
-            case BLOCK_NODE: {
-                Value result(0);
-                for (auto child : node->children) {
-                    result = evaluate(child);
-                }
-                return result;
-            }
-            
-            case VARIABLE_DECL_NODE: {
-                if (!node->children.empty()) {
-                    Value value = evaluate(node->children[0]);
-                    variables[node->value] = value;
-                    return value;
-                } else {
-		    std::cerr << "Warning: variable '" << node->value <<"' declared without initialization (defaulting to 0)\n";
-		    variables[node->value] = Value(0);
-                    return Value(0);
-                }
-            }
-            
-            case ASSIGNMENT_NODE: {
-                Value value = evaluate(node->children[0]);
-                variables[node->value] = value;
-                return value;
-            }
-            
-            case VARIABLE_NODE: {
-                if (variables.find(node->value) == variables.end()) {
-                    throw std::runtime_error("Undefined variable: " + node->value);
-                }
-                return variables[node->value];
-            }
-            
-            case IF_NODE: {
-                Value condition = evaluate(node->children[0]);
-                if (condition.type != Value::INT) {
-                    throw std::runtime_error("If condition must be integer");
-                }
-                
-                if (condition.intValue != 0) {
-                    return evaluate(node->children[1]);
-                } else if (node->children.size() > 2) {
-                    return evaluate(node->children[2]);
-                }
-                return Value(0);
-            }
-            
-            case WHILE_NODE: {
-                Value result(0);
-                while (true) {
-                    Value condition = evaluate(node->children[0]);
-                    if (condition.type != Value::INT || condition.intValue == 0) {
-                        break;
-                    }
-                    result = evaluate(node->children[1]);
-                }
-                return result;
-            }
-            
-            case COMPARISON_NODE: {
-                Value left = evaluate(node->children[0]);
-                Value right = evaluate(node->children[1]);
-                
-                if (left.type != Value::INT || right.type != Value::INT) {
-                    throw std::runtime_error("Comparison operations only supported on integers");
-                }
-                
-                if (node->value == "==") return Value(left.intValue == right.intValue ? 1 : 0);
-                if (node->value == "!=") return Value(left.intValue != right.intValue ? 1 : 0);
-                if (node->value == "<") return Value(left.intValue < right.intValue ? 1 : 0);
-                if (node->value == ">") return Value(left.intValue > right.intValue ? 1 : 0);
-		if (node->value == "<=") return Value(left.intValue <= right.intValue ? 1 : 0);
-		if (node->value == ">=") return Value(left.intValue >= right.intValue ? 1 : 0);
-                
-                throw std::runtime_error("Unknown comparison operator: " + node->value);
-            }
-                
-            case ARITHMETIC_NODE: {
-                Value left = evaluate(node->children[0]);
-                Value right = evaluate(node->children[1]);
-                
-                if (left.type != Value::INT || right.type != Value::INT) {
-                    throw std::runtime_error("Arithmetic operations only supported on numbers");
-                }
-                
-                if (node->value == "+") return Value(left.intValue + right.intValue);
-                if (node->value == "-") return Value(left.intValue - right.intValue);
-                if (node->value == "*") return Value(left.intValue * right.intValue);
-                if (node->value == "/") {
-                    if (right.intValue == 0) throw std::runtime_error("Division by zero");
-                    return Value(left.intValue / right.intValue);
-                }
-                throw std::runtime_error("Unknown arithmetic operator: " + node->value);
-            }
-                
-            case NUMBER_NODE: {
-                return Value(std::stoi(node->value));
-            }
-            
-            case STRING_NODE: {
-                return Value(node->value);
-            }
-            
-            case FUNCTION_CALL_NODE: {
-                if (node->value == "printa") {
-                    if (node->children.size() != 1) {
-                        throw std::runtime_error("print() function expects exactly 1 argument");
-                    }
-                    Value value = evaluate(node->children[0]);
-                    if (value.type == Value::INT) {
-                        std::cout << value.intValue;
-                    } else {
-                        std::cout << value.stringValue;
-                    }
-                    return value;
-                } else if (node->value == "compile") {
-                    if (node->children.size() != 1) {
-                        throw std::runtime_error("compile() function expects exactly 1 argument");
-                    }
-                    Value filename = evaluate(node->children[0]);
-                    if (filename.type != Value::STRING) {
-                        throw std::runtime_error("compile() function expects string argument");
-                    }
-                    
-                    // Read source file
-                    std::ifstream file(filename.stringValue);
-                    if (!file.is_open()) {
-                        throw std::runtime_error("Could not open file: " + filename.stringValue);
-                    }
-                    
-                    std::string sourceCode;
-                    std::string line;
-                    while (std::getline(file, line)) {
-                        sourceCode += line + "\n";
-                    }
-                    file.close();
-                    
-                    // Compile to C++
-                    Lexer lexer(sourceCode);
-                    std::vector<Token> tokens = lexer.tokenize();
-                    Parser parser(tokens);
-                    ASTNode* ast = parser.parse();
-                    
-                    // Generate C++ code
-                    std::string cppCode = generateCppCode(ast);
-                    
-                    // Write to output file
-                    std::string outputName = filename.stringValue;
-                    size_t dotPos = outputName.find_last_of('.');
-                    if (dotPos != std::string::npos) {
-                        outputName = outputName.substr(0, dotPos);
-                    }
-                    outputName += ".cpp";
-                    
-                    std::ofstream outFile(outputName);
-                    outFile << cppCode;
-                    outFile.close();
-                    
-                    std::cout << "Compiled " << filename.stringValue << " to " << outputName << std::endl;
-                    
-                    delete ast;
-                    return Value(0);
-                } else {
-                    throw std::runtime_error("Unknown function: " + node->value);
-                }
-            }
-            
-            case RETURN_NODE: {
-                if (!node->children.empty()) {
-                    return evaluate(node->children[0]);
-                }
-                return Value(0);
-            }
-                
-            default: {
-                throw std::runtime_error("Unknown node type");
-            }
+    while (true) {
+        if (interactive) {
+            std::cout << (chunk.empty() ? "npav> " : "...> ") << std::flush;
         }
-    }
-    
-    std::string generateCppCode(ASTNode* node) {
-        std::stringstream cpp;
-        
-        cpp << "#include <iostream>\n";
-        cpp << "#include <string>\n\n";
-        cpp << "int main() {\n";
-        
-        if (node->type == PROGRAM_NODE && !node->children.empty()) {
-            ASTNode* mainFunc = node->children[0];
-            if (mainFunc->type == MAIN_FUNCTION_NODE) {
-                for (auto child : mainFunc->children) {
-                    cpp << "    " << generateStatementCode(child) << "\n";
-                }
-            }
+        if (!std::getline(std::cin, line)) {
+            break;
         }
-        
-        cpp << "    return 0;\n";
-        cpp << "}\n";
-        
-        return cpp.str();
-    }
-    private: 
-    std::string generateStatementCode(ASTNode* node) {
-        switch (node->type) {
-            case VARIABLE_DECL_NODE: {
-                std::string code = "int " + node->value;
-                if (!node->children.empty()) {
-                    code += " = " + generateExpressionCode(node->children[0]);
-                }
-                return code + ";";
-            }
-            
-            case ASSIGNMENT_NODE: {
-                return node->value + " = " + generateExpressionCode(node->children[0]) + ";";
-            }
-            
-            case FUNCTION_CALL_NODE: {
-                if (node->value == "print") {
-                    return "std::cout << " + generateExpressionCode(node->children[0]) + ";";
-                }
-                return node->value + "();";
-            }
-            
-            default: {
-                return generateExpressionCode(node) + ";";
+        if (chunk.empty()) {
+            if (line == ":q" || line == ":quit") {
+                break;
+            } else if (line == ":reset") {
+                session.reset();
+                continue;
+            } else if (line == ":help") {
+                std::cout << "Enter statements or function definitions; an expression on its own shows its value." << std::endl;
+                std::cout << "  :reset   forget all variables and functions" << std::endl;
+                std::cout << "  :quit    leave (or end of input)" << std::endl;
+                continue;
             }
         }
-    }
-    
-    std::string generateExpressionCode(ASTNode* node) {
-        switch (node->type) {
-            case NUMBER_NODE: {
-                return node->value;
-            }
-            
-            case STRING_NODE: {
-                return "\"" + node->value + "\"";
-            }
-            
-            case VARIABLE_NODE: {
-                return node->value;
-            }
-            
-            case ARITHMETIC_NODE: {
-                return "(" + generateExpressionCode(node->children[0]) + " " + 
-                       node->value + " " + generateExpressionCode(node->children[1]) + ")";
-            }
-            
-            case FUNCTION_CALL_NODE: {
-                if (node->value == "print") {
-                    return "std::cout << " + generateExpressionCode(node->children[0]);
-                }
-                return node->value + "()";
-            }
-            
-            default: {
-                return "0";
-            }
+        chunk += line + "\n";
+        if (ReplSession::isComplete(chunk)) {
+            ok = session.execute(chunk, std::cout, std::cerr);
+            chunk.clear();
         }
     }
-};
-
+    // Whatever is left open at the end still runs, so its error gets reported
+    if (!chunk.empty()) {
+        ok = session.execute(chunk, std::cout, std::cerr);
+    }
+    if (interactive) {
+        std::cout << std::endl;
+    }
+    return ok ? 0 : 1;
+}
 
 int main(int argc, char* argv[]) {
     bool compileToExecutable = false;
+    RunOptions options;
+    TimeReport timeReport;
+    bool timeReportJson = false;
+    ExecutionProfile profile;
+    std::string foldedName;
     std::string filename;
     std::string outputName;
     
     // Parse command line arguments
     if (argc < 2) {
         std::cerr << "Usage: " << argv[0] << " <source_file> [options]" << std::endl;
+        std::cerr << "       " << argv[0] << " --repl [options]   Interactive session that keeps its state" << std::endl;
         std::cerr << "Options:" << std::endl;
         std::cerr << "  -c, --compile    Compile to executable binary" << std::endl;
         std::cerr << "  -o <name>        Specify output executable name" << std::endl;
+        std::cerr << "  --no-bounds-check  Skip array index checks (interpreter and compiled code)" << std::endl;
+        std::cerr << "  --max-stack <n>  Limit the interpreter's work stack to n entries" << std::endl;
+        std::cerr << "  --max-depth <n>  Limit the interpreter's call depth to n frames" << std::endl;
+        std::cerr << "  --time-report[=json]  Print time, CPU and peak heap per phase to stderr" << std::endl;
+        std::cerr << "  --profile[=<file>]  Print the hottest lines to stderr and write a folded" << std::endl;
+        std::cerr << "                   stack profile to <file> (default <source_file>.folded)" << std::endl;
+        std::cerr << "  --watch          Rebuild whenever the file (or a file it compile()s) changes" << std::endl;
         return 1;
     }
     
     filename = argv[1];
     
     // Parse additional arguments
+    bool repl = filename == "--repl";
+    bool watch = false;
     for (int i = 2; i < argc; i++) {
         std::string arg = argv[i];
         if (arg == "-c" || arg == "--compile") {
             compileToExecutable = true;
         } else if (arg == "-o" && i + 1 < argc) {
             outputName = argv[++i];
+        } else if (arg == "--no-bounds-check") {
+            options.boundsChecks = false;
+        } else if ((arg == "--max-stack" || arg == "--max-depth") && i + 1 < argc) {
+            size_t& limit = arg == "--max-stack" ? options.maxStack : options.maxDepth;
+            if (!parseLimit(argv[++i], limit)) {
+                std::cerr << "Error: Invalid value for " << arg << ": '" << argv[i] << "'" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--time-report" || arg == "--time-report=json") {
+            options.timeReport = &timeReport;
+            timeReportJson = arg == "--time-report=json";
+            trackHeapIn(timeReport);
+        } else if (arg == "--profile" || arg.rfind("--profile=", 0) == 0) {
+            options.profile = &profile;
+            foldedName = arg.length() > 10 ? arg.substr(10) : filename + ".folded";
+        } else if (arg == "--watch") {
+            watch = true;
         }
     }
     
-    // Read source file
-    std::string sourceCode;
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Error: Could not open file '" << filename << "'" << std::endl;
-        return 1;
+    if (watch) {
+        if (options.timeReport || options.profile) {
+            std::cerr << "Error: --watch can't be combined with --time-report or --profile" << std::endl;
+            return 1;
+        }
+        return runWatch(filename, compileToExecutable, outputName, options);
     }
     
-    std::string line;
-    while (std::getline(file, line)) {
-        sourceCode += line + "\n";
+    if (repl) {
+        return runRepl(options);
+    }
+    
+    if (options.timeReport) {
+        setHeapTracking(true);
+    }
+    
+    // Read source file
+    std::string sourceCode;
+    {
+        TimeReport::Phase phase(options.timeReport, "read");
+        if (!readSource(filename, sourceCode)) {
+            std::cerr << "Error: Could not open file '" << filename << "'" << std::endl;
+            return 1;
+        }
     }
-    file.close();
     
     if (sourceCode.empty()) {
         std::cerr << "Error: File '" << filename << "' is empty" << std::endl;
         return 1;
     }
     
-    try {
-        Lexer lexer(sourceCode);
-        std::vector<Token> tokens = lexer.tokenize();
-        
-        Parser parser(tokens);
-        ASTNode* ast = parser.parse();
-        
-        if (compileToExecutable) {
-            // Use the existing Evaluator class to generate C++ code
-            Evaluator evaluator;
-            std::string cppCode = evaluator.generateCppCode(ast);
-            
-            // Create temporary C++ file
-            std::string tempCppFile = filename + ".temp.cpp";
-            std::ofstream outFile(tempCppFile);
-            outFile << cppCode;
-            outFile.close();
-            
-            // Determine output executable name
-            if (outputName.empty()) {
-                outputName = filename;
-                size_t dotPos = outputName.find_last_of('.');
-                if (dotPos != std::string::npos) {
-                    outputName = outputName.substr(0, dotPos);
-                }
-                #ifdef _WIN32
-                outputName += ".exe";
-                #endif
-            }
-            
-            // Compile with g++
-            std::string compileCommand = "g++ -std=c++17 -o " + outputName + " " + tempCppFile;
-            std::cout << "Compiling: " << compileCommand << std::endl;
-            
-            int result = system(compileCommand.c_str());
-            
-            // Clean up temporary file
-            std::remove(tempCppFile.c_str());
-            
-            if (result == 0) {
-                std::cout << "Successfully compiled " << filename << " to " << outputName << std::endl;
-            } else {
-                std::cerr << "Compilation failed!" << std::endl;
-                return 1;
-            }
+    int result;
+    if (compileToExecutable) {
+        result = compileProgram(filename, sourceCode, outputName, options, std::cout, std::cerr);
+    } else {
+        // Default behavior - interpret the code
+        std::cout << "Interpreting file: " << filename << std::endl;
+        result = runProgram(filename, sourceCode, options, std::cout, std::cerr);
+    }
+    setHeapTracking(false);
+    
+    if (options.profile && !compileToExecutable) {
+        std::cout.flush();
+        profile.print(sourceCode, std::cerr);
+        std::ofstream folded(foldedName);
+        if (folded) {
+            profile.writeFolded(folded);
+            std::cerr << "Folded stacks written to " << foldedName << std::endl;
         } else {
-            // Default behavior - interpret the code
-            std::cout << "Interpreting file: " << filename << std::endl;
-            Evaluator evaluator;
-            Value result = evaluator.evaluate(ast);
+            std::cerr << "Error: Could not write '" << foldedName << "'" << std::endl;
         }
-        
-        delete ast;
-        
-    } catch (const std::exception& e) {
-        std::cerr << "Error: " << e.what() << std::endl;
-        return 1;
     }
     
-    return 0;
+    if (options.timeReport) {
+        std::cout.flush();
+        timeReport.print(filename, std::cerr, timeReportJson);
+    }
+    return result;
 }
@@ -0,0 +1,3171 @@
+#include "npavc_core.h"
+
+#include <cstdio>
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <sys/stat.h>
+#endif
+
+const char* tokenTypeName(TokenType type) {
+    switch (type) {
+        case VOID: return "'void'";
+        case MAIN: return "'main'";
+        case LPAREN: return "'('";
+        case RPAREN: return "')'";
+        case LBRACE: return "'{'";
+        case RBRACE: return "'}'";
+        case NUMBER: return "number";
+        case PLUS: return "'+'";
+        case MINUS: return "'-'";
+        case MULTIPLY: return "'*'";
+        case DIVIDE: return "'/'";
+        case MODULO: return "'%'";
+        case SEMICOLON: return "';'";
+        case IDENTIFIER: return "identifier";
+        case COMMA: return "','";
+        case STRING: return "string literal";
+        case ASSIGN: return "'='";
+        case INT: return "'int'";
+        case STRING_TYPE: return "'string'";
+        case IF: return "'if'";
+        case ELSE: return "'else'";
+        case WHILE: return "'while'";
+        case FOR: return "'for'";
+        case RETURN: return "'return'";
+        case LBRACKET: return "'['";
+        case RBRACKET: return "']'";
+        case EQUAL: return "'=='";
+        case NOT_EQUAL: return "'!='";
+        case LESS_THAN: return "'<'";
+        case GREATER_THAN: return "'>'";
+        case LESS_THAN_OR_EQUAL: return "'<='";
+        case GREATER_THAN_OR_EQUAL: return "'>='";
+        case AND: return "'&&'";
+        case OR: return "'||'";
+        case EOF_TOKEN: return "end of file";
+        default: return "unknown token";
+    }
+}
+
+std::string SyntaxError::summarize(const std::vector<Diagnostic>& found) {
+    std::string text;
+    for (const auto& diagnostic : found) {
+        if (!text.empty()) text += "\n";
+        text += "line " + std::to_string(diagnostic.line) + ", column " + 
+                std::to_string(diagnostic.column) + ": " + diagnostic.message;
+    }
+    return text;
+}
+
+void Lexer::advance() {
+    if (pos < source.length()) {
+        if (source[pos] == '\n') {
+            line++;
+            column = 1;
+        } else {
+            column++;
+        }
+        pos++;
+    }
+}
+
+void Lexer::skipComment() {
+	    if (currentChar() == '/' && peekChar() == '/') {
+		    while (currentChar() != '\n' && currentChar() != '\0') {
+			    advance();
+		    }
+	    }
+	    else if (currentChar() == '/' && peekChar() == '*') {
+		    advance();
+		    advance();
+		    while (currentChar() != '\0') {
+			    if (currentChar() == '*' && peekChar() == '/') {
+				    advance();
+				    advance();
+				    break;
+			    }
+			    advance();
+		    }
+	    }
+}
+
+Token Lexer::makeNumber() {
+    std::string num;
+    int startCol = column;
+    
+    while (isdigit(currentChar())) {
+        num += currentChar();
+        advance();
+    }
+    
+    return Token(NUMBER, num, line, startCol);
+}
+
+Token Lexer::makeString() {
+    std::string str;
+    int startLine = line;
+    int startCol = column;
+    
+    advance(); // Skip opening quote
+    
+    while (currentChar() != '"' && currentChar() != '\0') {
+        if (currentChar() == '\\') {
+            advance(); // Skip backslash
+            char escaped = currentChar();
+            switch (escaped) {
+                case 'n': str += '\n'; break;
+                case 't': str += '\t'; break;
+                case 'r': str += '\r'; break;
+                case '\\': str += '\\'; break;
+                case '"': str += '"'; break;
+                default: 
+                    str += '\\';
+                    str += escaped;
+                    break;
+            }
+            advance();
+        } else {
+            str += currentChar();
+            advance();
+        }
+    }
+    
+    if (currentChar() == '"') {
+        advance(); // Skip closing quote
+    } else {
+        throw std::runtime_error("Unterminated string literal at line " + std::to_string(line));
+    }
+    
+    return Token(STRING, str, startLine, startCol);
+}
+
+Token Lexer::makeIdentifier() {
+    std::string id;
+    int startCol = column;
+    
+    while (isalnum(currentChar()) || currentChar() == '_') {
+        id += currentChar();
+        advance();
+    }
+    
+    // Check for keywords
+    if (id == "void") return Token(VOID, id, line, startCol);
+    if (id == "main") return Token(MAIN, id, line, startCol);
+    if (id == "int") return Token(INT, id, line, startCol);
+    if (id == "string") return Token(STRING_TYPE, id, line, startCol);
+    if (id == "if") return Token(IF, id, line, startCol);
+    if (id == "else") return Token(ELSE, id, line, startCol);
+    if (id == "while") return Token(WHILE, id, line, startCol);
+    if (id == "for") return Token(FOR, id, line, startCol);
+    if (id == "return") return Token(RETURN, id, line, startCol);
+    
+    return Token(IDENTIFIER, id, line, startCol);
+}
+
+bool Lexer::lexNext(std::vector<Token>& tokens) {
+    skipWhitespace();
+    
+    if (currentChar() == '\0') return false;
+    
+    char ch = currentChar();
+    int startCol = column;
+    size_t startPos = pos;
+    size_t count = tokens.size();
+    
+    if (isdigit(ch)) {
+        tokens.push_back(makeNumber());
+    } else if (ch == '"') {
+        tokens.push_back(makeString());
+    } else if (isalpha(ch) || ch == '_') {
+        tokens.push_back(makeIdentifier());
+    } else {
+        switch (ch) {
+            case '(': tokens.push_back(Token(LPAREN, "(", line, startCol)); advance(); break;
+            case ')': tokens.push_back(Token(RPAREN, ")", line, startCol)); advance(); break;
+            case '{': tokens.push_back(Token(LBRACE, "{", line, startCol)); advance(); break;
+            case '}': tokens.push_back(Token(RBRACE, "}", line, startCol)); advance(); break;
+            case '[': tokens.push_back(Token(LBRACKET, "[", line, startCol)); advance(); break;
+            case ']': tokens.push_back(Token(RBRACKET, "]", line, startCol)); advance(); break;
+            case '+': tokens.push_back(Token(PLUS, "+", line, startCol)); advance(); break;
+            case '-': tokens.push_back(Token(MINUS, "-", line, startCol)); advance(); break;
+            case '*': tokens.push_back(Token(MULTIPLY, "*", line, startCol)); advance(); break;
+            case '/': 
+			      if (peekChar() == '/' || peekChar() == '*') {
+				      skipComment();
+				      break;
+			      }
+			      else {
+			      	tokens.push_back(Token(DIVIDE, "/", line, startCol)); advance(); break;
+			      }
+            case '%': tokens.push_back(Token(MODULO, "%", line, startCol)); advance(); break;
+            case ';': tokens.push_back(Token(SEMICOLON, ";", line, startCol)); advance(); break;
+            case ',': tokens.push_back(Token(COMMA, ",", line, startCol)); advance(); break;
+            case '=':
+                if (peekChar() == '=') {
+                    tokens.push_back(Token(EQUAL, "==", line, startCol));
+                    advance(); advance();
+                } else {
+                    tokens.push_back(Token(ASSIGN, "=", line, startCol));
+                    advance();
+                }
+                break;
+            case '!':
+                if (peekChar() == '=') {
+                    tokens.push_back(Token(NOT_EQUAL, "!=", line, startCol));
+                    advance(); advance();
+                } else {
+                    warnings << "Warning: Unknown character '" << ch << "' at line " 
+                             << line << ", column " << column << std::endl;
+                    advance();
+                }
+                break;
+            case '&':
+            case '|':
+                if (peekChar() == ch) {
+                    tokens.push_back(Token(ch == '&' ? AND : OR, std::string(2, ch), line, startCol));
+                    advance(); advance();
+                } else {
+                    warnings << "Warning: Unknown character '" << ch << "' at line " 
+                             << line << ", column " << column << std::endl;
+                    advance();
+                }
+                break;
+            case '<': 
+			if (peekChar() == '=') {
+				tokens.push_back(Token(LESS_THAN_OR_EQUAL, "<=", line, startCol));
+				advance(); advance();
+			}
+			else {
+				tokens.push_back(Token(LESS_THAN, "<", line, startCol));
+				advance();
+			}
+			break;
+            case '>': 
+			      if (peekChar() == '=') {
+				      tokens.push_back(Token(GREATER_THAN_OR_EQUAL, ">=", line, startCol));
+				      advance(); advance();
+			      }
+			      else {
+				      tokens.push_back(Token(GREATER_THAN, ">", line, startCol));
+				      advance();
+			      }
+			      break;
+			      
+		    default:
+                warnings << "Warning: Unknown character '" << ch << "' at line " 
+                         << line << ", column " << column << std::endl;
+                advance();
+                break;
+        }
+    }
+    
+    if (tokens.size() > count) {
+        tokens.back().start = startPos;
+        tokens.back().end = pos;
+    }
+    return true;
+}
+
+std::vector<Token> Lexer::tokenize() {
+    std::vector<Token> tokens;
+    while (lexNext(tokens)) {}
+    tokens.push_back(endOfFile());
+    return tokens;
+}
+
+LexState Lexer::lexLine(const std::string& text, LexState state, std::vector<LexSpan>& spans) {
+    std::ostream discard(nullptr);  // highlighting has no use for warnings
+    Lexer lexer(text, discard);
+    
+    // Finish what the previous line left open
+    if (state == LEX_BLOCK_COMMENT) {
+        size_t close = text.find("*/");
+        if (close == std::string::npos) {
+            if (!text.empty()) spans.push_back({0, text.size(), UNKNOWN, true});
+            return LEX_BLOCK_COMMENT;
+        }
+        spans.push_back({0, close + 2, UNKNOWN, true});
+        lexer.seek(close + 2, 1, static_cast<int>(close) + 3);
+    } else if (state == LEX_STRING) {
+        size_t close = 0;
+        while (close < text.size() && text[close] != '"') {
+            close += text[close] == '\\' ? 2 : 1;
+        }
+        if (close >= text.size()) {
+            if (!text.empty()) spans.push_back({0, text.size(), STRING, false});
+            return LEX_STRING;
+        }
+        spans.push_back({0, close + 1, STRING, false});
+        lexer.seek(close + 1, 1, static_cast<int>(close) + 2);
+    }
+    
+    std::vector<Token> tokens;
+    for (;;) {
+        size_t at = lexer.offset();
+        while (at < text.size() && isspace(static_cast<unsigned char>(text[at]))) at++;
+        bool commentStart = text.compare(at, 2, "//") == 0 || text.compare(at, 2, "/*") == 0;
+        tokens.clear();
+        try {
+            if (!lexer.lexNext(tokens)) return LEX_CODE;
+        } catch (const std::runtime_error&) {
+            // A string still open at the end of the line
+            spans.push_back({at, text.size(), STRING, false});
+            return LEX_STRING;
+        }
+        if (!tokens.empty()) {
+            spans.push_back({tokens.back().start, tokens.back().end, tokens.back().type, false});
+        } else if (commentStart) {
+            size_t end = lexer.offset();
+            spans.push_back({at, end, UNKNOWN, true});
+            bool closed = text[at + 1] == '/' || (end - at >= 4 && text.compare(end - 2, 2, "*/") == 0);
+            if (!closed) return LEX_BLOCK_COMMENT;
+        }
+    }
+}
+
+const char* nodeTypeName(NodeType type) {
+    switch (type) {
+        case PROGRAM_NODE: return "Program";
+        case MAIN_FUNCTION_NODE: return "MainFunction";
+        case ARITHMETIC_NODE: return "Arithmetic";
+        case NUMBER_NODE: return "Number";
+        case FUNCTION_CALL_NODE: return "FunctionCall";
+        case STRING_NODE: return "String";
+        case VARIABLE_NODE: return "Variable";
+        case ASSIGNMENT_NODE: return "Assignment";
+        case IF_NODE: return "If";
+        case WHILE_NODE: return "While";
+        case COMPARISON_NODE: return "Comparison";
+        case BLOCK_NODE: return "Block";
+        case RETURN_NODE: return "Return";
+        case FUNCTION_DEF_NODE: return "FunctionDef";
+        case VARIABLE_DECL_NODE: return "VariableDecl";
+        case STRING_DECL_NODE: return "StringDecl";
+        case ARRAY_DECL_NODE: return "ArrayDecl";
+        case INDEX_NODE: return "Index";
+        case ARRAY_ASSIGN_NODE: return "ArrayAssign";
+        case FOR_NODE: return "For";
+        case LOGICAL_NODE: return "Logical";
+        case UNARY_NODE: return "Unary";
+        default: return "Unknown";
+    }
+}
+
+ASTNode::~ASTNode() {
+    std::vector<ASTNode*> pending;
+    pending.swap(children);
+    while (!pending.empty()) {
+        ASTNode* node = pending.back();
+        pending.pop_back();
+        pending.insert(pending.end(), node->children.begin(), node->children.end());
+        node->children.clear();
+        delete node;
+    }
+}
+
+ASTNode* ASTNode::copy() const {
+    auto duplicate = [](const ASTNode* node) {
+        ASTNode* result = new ASTNode(node->type, node->value);
+        result->start = node->start;
+        result->end = node->end;
+        result->line = node->line;
+        result->column = node->column;
+        return result;
+    };
+    ASTNode* root = duplicate(this);
+    // Each entry is an original whose copy's children are still to be made
+    std::vector<std::pair<const ASTNode*, ASTNode*>> pending{{this, root}};
+    try {
+        while (!pending.empty()) {
+            auto [original, copied] = pending.back();
+            pending.pop_back();
+            for (auto child : original->children) {
+                copied->children.push_back(duplicate(child));
+                pending.push_back({child, copied->children.back()});
+            }
+        }
+    } catch (...) {
+        delete root;
+        throw;
+    }
+    return root;
+}
+
+const Token& Parser::currentToken() {
+    if (pos >= tokens.size()) {
+        static const Token eofToken(EOF_TOKEN, "", 0, 0);
+        return eofToken;
+    }
+    return tokens[pos];
+}
+
+std::string Parser::describe(const Token& token) {
+    std::string name = tokenTypeName(token.type);
+    if (token.type == IDENTIFIER || token.type == NUMBER) {
+        name += " '" + token.value + "'";
+    }
+    return name;
+}
+
+void Parser::expect(TokenType type) {
+    if (currentToken().type != type) {
+        throw ParseError(currentToken(), std::string("Expected ") + tokenTypeName(type) + 
+                                         " but got " + describe(currentToken()));
+    }
+    advance();
+}
+
+void Parser::report(const ParseError& error) {
+    diagnostics.push_back({error.line, error.column, error.what(), error.offset});
+    if (diagnostics.size() >= MAX_DIAGNOSTICS) {
+        throw SyntaxError(diagnostics);
+    }
+}
+
+void Parser::synchronize() {
+    int depth = 0;
+    while (currentToken().type != EOF_TOKEN) {
+        TokenType type = currentToken().type;
+        if (type == RBRACE) {
+            if (depth == 0) return;
+            if (--depth == 0) {
+                advance();
+                return;
+            }
+        } else if (type == LBRACE) {
+            depth++;
+        } else if (type == SEMICOLON && depth == 0) {
+            advance();
+            return;
+        }
+        advance();
+    }
+}
+
+void Parser::parseStatementsInto(ASTNode* block) {
+    while (currentToken().type != RBRACE && currentToken().type != EOF_TOKEN) {
+        try {
+            block->children.push_back(parseStatement());
+        } catch (const ParseError& error) {
+            report(error);
+            synchronize();
+        }
+    }
+}
+
+const Parser::BinaryOperator& Parser::binaryOperator(TokenType type) {
+    static const std::vector<BinaryOperator> table = [] {
+        std::vector<BinaryOperator> operators(UNKNOWN + 1, {0, ARITHMETIC_NODE});
+        operators[OR] = {1, LOGICAL_NODE};
+        operators[AND] = {2, LOGICAL_NODE};
+        operators[EQUAL] = operators[NOT_EQUAL] = {3, COMPARISON_NODE};
+        operators[LESS_THAN] = operators[GREATER_THAN] = {4, COMPARISON_NODE};
+        operators[LESS_THAN_OR_EQUAL] = operators[GREATER_THAN_OR_EQUAL] = {4, COMPARISON_NODE};
+        operators[PLUS] = operators[MINUS] = {5, ARITHMETIC_NODE};
+        operators[MULTIPLY] = operators[DIVIDE] = operators[MODULO] = {6, ARITHMETIC_NODE};
+        return operators;
+    }();
+    return table[type];
+}
+
+ASTNode* Parser::parseExpression() {
+    std::vector<ASTNode*> operands;
+    std::vector<PendingOperator> operators;
+    
+    // Pops one operator and applies it to the operand(s) on top of the stack
+    auto reduce = [&]() {
+        PendingOperator op = operators.back();
+        operators.pop_back();
+        if (op.kind == PendingOperator::UNARY) {
+            ASTNode* node = new ASTNode(UNARY_NODE, op.token.value);
+            node->children.push_back(operands.back());
+            operands.back() = node;
+            return;
+        }
+        ASTNode* node = new ASTNode(binaryOperator(op.token.type).node, op.token.value);
+        node->children.push_back(operands[operands.size() - 2]);
+        node->children.push_back(operands.back());
+        operands.pop_back();
+        operands.back() = node;
+    };
+    auto reduceWhile = [&](int precedence) {
+        while (!operators.empty() && pendingPrecedence(operators.back()) >= precedence) {
+            reduce();
+        }
+    };
+    
+    try {
+        while (true) {
+            // Operand position: prefix operators and open groups, then a primary
+            const Token& token = currentToken();
+            if (token.type == LPAREN || token.type == MINUS) {
+                advance();
+                operators.push_back({token.type == LPAREN ? PendingOperator::GROUP : PendingOperator::UNARY,
+                                     token, nullptr});
+                continue;
+            }
+            if (token.type == NUMBER || token.type == STRING) {
+                operands.push_back(new ASTNode(token.type == NUMBER ? NUMBER_NODE : STRING_NODE, token.value));
+                advance();
+            } else if (token.type == IDENTIFIER) {
+                advance();
+                if (currentToken().type == LBRACKET) {
+                    // Array element - the index is parsed as a nested expression
+                    advance(); // consume '['
+                    operators.push_back({PendingOperator::INDEX, token, new ASTNode(INDEX_NODE, token.value)});
+                    continue;
+                } else if (currentToken().type == LPAREN) {
+                    // Function call
+                    advance(); // consume '('
+                    ASTNode* funcCall = new ASTNode(FUNCTION_CALL_NODE, token.value);
+                    if (currentToken().type != RPAREN) {
+                        operators.push_back({PendingOperator::CALL, token, funcCall});
+                        continue;
+                    }
+                    advance(); // consume ')'
+                    operands.push_back(funcCall);
+                } else {
+                    // Variable reference
+                    operands.push_back(new ASTNode(VARIABLE_NODE, token.value));
+                }
+            } else {
+                throw ParseError(token, "Expected number, string, identifier, or '(' but got " + 
+                                        describe(token));
+            }
+            
+            // Operator position: closing brackets finish whatever they close,
+            // a binary operator sends us back for its right operand
+            while (true) {
+                int precedence = binaryOperator(currentToken().type).precedence;
+                if (precedence > 0) {
+                    reduceWhile(precedence);
+                    operators.push_back({PendingOperator::BINARY, currentToken(), nullptr});
+                    advance();
+                    break;
+                }
+                
+                reduceWhile(1);
+                if (operators.empty()) {
+                    ASTNode* result = operands.back();
+                    operands.pop_back();
+                    return result;
+                }
+                
+                PendingOperator& open = operators.back();
+                if (open.kind == PendingOperator::CALL && currentToken().type == COMMA) {
+                    advance();
+                    open.node->children.push_back(operands.back());
+                    operands.pop_back();
+                    break;
+                }
+                
+                expect(open.kind == PendingOperator::INDEX ? RBRACKET : RPAREN);
+                if (open.kind != PendingOperator::GROUP) {
+                    open.node->children.push_back(operands.back());
+                    operands.back() = open.node;
+                }
+                operators.pop_back();
+            }
+        }
+    } catch (...) {
+        for (auto operand : operands) delete operand;
+        for (auto& open : operators) delete open.node;
+        throw;
+    }
+}
+
+ASTNode* Parser::parseAssignmentOrExpression() {
+    size_t start = pos;
+    if (currentToken().type != IDENTIFIER) {
+        return parseExpression();
+    }
+    std::string name = currentToken().value;
+    advance();
+    
+    if (currentToken().type == LBRACKET) {
+        advance(); // consume '['
+        std::unique_ptr<ASTNode> assignment(new ASTNode(ARRAY_ASSIGN_NODE, name));
+        assignment->children.push_back(parseExpression());
+        expect(RBRACKET);
+        
+        if (currentToken().type == ASSIGN) {
+            advance(); // consume '='
+            assignment->children.push_back(parseExpression());
+            return assignment.release();
+        }
+        // Not an element store - reparse as an expression
+    } else if (currentToken().type == ASSIGN) {
+        advance(); // consume '='
+        ASTNode* value = parseExpression();
+        
+        ASTNode* assignment = new ASTNode(ASSIGNMENT_NODE, name);
+        assignment->children.push_back(value);
+        return assignment;
+    }
+    
+    // Put the identifier back for expression parsing
+    pos = start;
+    return parseExpression();
+}
+
+ASTNode* Parser::parseStatement() {
+    size_t first = pos;
+    ASTNode* stmt = parseStatementNode();
+    setRange(stmt, first);
+    return stmt;
+}
+
+// Nodes are built before their children are parsed and held in a
+// unique_ptr until returned, so a ParseError thrown part way through
+// (which recovery catches and carries on from) frees what was built so far
+ASTNode* Parser::parseStatementNode() {
+    if (currentToken().type == INT || currentToken().type == STRING_TYPE) {
+        // Variable declaration
+        NodeType declType = currentToken().type == INT ? VARIABLE_DECL_NODE : STRING_DECL_NODE;
+        advance(); // consume 'int' / 'string'
+        std::string varName = currentToken().value;
+        expect(IDENTIFIER);
+        
+        if (currentToken().type == LBRACKET) {
+            // Fixed-size array declaration: int name[N];
+            if (declType != VARIABLE_DECL_NODE) {
+                throw ParseError(currentToken(), "Only int arrays are supported");
+            }
+            advance(); // consume '['
+            if (currentToken().type != NUMBER) {
+                throw ParseError(currentToken(), "Array size must be an integer constant");
+            }
+            std::unique_ptr<ASTNode> arrayDecl(new ASTNode(ARRAY_DECL_NODE, varName));
+            arrayDecl->children.push_back(new ASTNode(NUMBER_NODE, currentToken().value));
+            advance();
+            expect(RBRACKET);
+            expect(SEMICOLON);
+            return arrayDecl.release();
+        }
+        
+        std::unique_ptr<ASTNode> varDecl(new ASTNode(declType, varName));
+        
+        if (currentToken().type == ASSIGN) {
+            advance(); // consume '='
+            varDecl->children.push_back(parseExpression());
+        }
+        
+        expect(SEMICOLON);
+        return varDecl.release();
+    } else if (currentToken().type == IDENTIFIER) {
+        // Assignment or expression
+        std::unique_ptr<ASTNode> stmt(parseAssignmentOrExpression());
+        expect(SEMICOLON);
+        return stmt.release();
+    } else if (currentToken().type == IF) {
+        advance(); // consume 'if'
+        expect(LPAREN);
+        std::unique_ptr<ASTNode> ifNode(new ASTNode(IF_NODE));
+        ifNode->children.push_back(parseExpression());
+        expect(RPAREN);
+        ifNode->children.push_back(parseStatement());
+        
+        if (currentToken().type == ELSE) {
+            advance(); // consume 'else'
+            ifNode->children.push_back(parseStatement());
+        }
+        
+        return ifNode.release();
+    } else if (currentToken().type == WHILE) {
+        advance(); // consume 'while'
+        expect(LPAREN);
+        std::unique_ptr<ASTNode> whileNode(new ASTNode(WHILE_NODE));
+        whileNode->children.push_back(parseExpression());
+        expect(RPAREN);
+        whileNode->children.push_back(parseStatement());
+        return whileNode.release();
+    } else if (currentToken().type == FOR) {
+        // for (init; condition; step) body - empty clauses become an
+        // empty block (init/step) or a constant true condition
+        advance(); // consume 'for'
+        expect(LPAREN);
+        std::unique_ptr<ASTNode> forNode(new ASTNode(FOR_NODE));
+        
+        if (currentToken().type == SEMICOLON) {
+            advance();
+            forNode->children.push_back(new ASTNode(BLOCK_NODE));
+        } else {
+            forNode->children.push_back(parseStatement());
+        }
+        
+        if (currentToken().type == SEMICOLON) {
+            forNode->children.push_back(new ASTNode(NUMBER_NODE, "1"));
+        } else {
+            forNode->children.push_back(parseExpression());
+        }
+        expect(SEMICOLON);
+        
+        if (currentToken().type == RPAREN) {
+            forNode->children.push_back(new ASTNode(BLOCK_NODE));
+        } else {
+            forNode->children.push_back(parseAssignmentOrExpression());
+        }
+        expect(RPAREN);
+        forNode->children.push_back(parseStatement());
+        return forNode.release();
+    } else if (currentToken().type == LBRACE) {
+        // Block
+        advance(); // consume '{'
+        std::unique_ptr<ASTNode> block(new ASTNode(BLOCK_NODE));
+        parseStatementsInto(block.get());
+        expect(RBRACE);
+        return block.release();
+    } else if (currentToken().type == RETURN) {
+        advance(); // consume 'return'
+        std::unique_ptr<ASTNode> returnNode(new ASTNode(RETURN_NODE));
+        
+        if (currentToken().type != SEMICOLON) {
+            returnNode->children.push_back(parseExpression());
+        }
+        
+        expect(SEMICOLON);
+        return returnNode.release();
+    } else {
+        // Expression statement
+        std::unique_ptr<ASTNode> expr(parseExpression());
+        expect(SEMICOLON);
+        return expr.release();
+    }
+}
+
+ASTNode* Parser::parseFunctionDefinition() {
+    size_t first = pos;
+    expect(INT);
+    std::string name = currentToken().value;
+    expect(IDENTIFIER);
+    expect(LPAREN);
+    
+    std::unique_ptr<ASTNode> funcDef(new ASTNode(FUNCTION_DEF_NODE, name));
+    
+    if (currentToken().type != RPAREN) {
+        while (true) {
+            expect(INT);
+            std::string param = currentToken().value;
+            expect(IDENTIFIER);
+            funcDef->children.push_back(new ASTNode(VARIABLE_DECL_NODE, param));
+            
+            if (currentToken().type != COMMA) {
+                break;
+            }
+            advance(); // consume ','
+        }
+    }
+    expect(RPAREN);
+    
+    if (currentToken().type != LBRACE) {
+        throw ParseError(currentToken(), "Expected '{' after parameters of function '" + name + 
+                                         "' but got " + describe(currentToken()));
+    }
+    funcDef->children.push_back(parseStatement());
+    setRange(funcDef.get(), first);
+    return funcDef.release();
+}
+
+void Parser::synchronizeTopLevel() {
+    int depth = 0;
+    while (currentToken().type != EOF_TOKEN) {
+        TokenType type = currentToken().type;
+        advance();
+        if (type == LBRACE) {
+            depth++;
+        } else if (type == RBRACE && --depth <= 0) {
+            return;
+        }
+    }
+}
+
+ASTNode* Parser::parseMainFunction() {
+    // Parse: void main() { ... }
+    size_t first = pos;
+    expect(VOID);
+    expect(MAIN);
+    expect(LPAREN);
+    expect(RPAREN);
+    expect(LBRACE);
+    
+    std::unique_ptr<ASTNode> mainFunc(new ASTNode(MAIN_FUNCTION_NODE));
+    parseStatementsInto(mainFunc.get());
+    expect(RBRACE);
+    setRange(mainFunc.get(), first);
+    return mainFunc.release();
+}
+
+ASTNode* Parser::parseProgram() {
+    ASTNode* program = new ASTNode(PROGRAM_NODE);
+    bool hasMain = false;
+    pos = 0;
+    diagnostics.clear();
+    
+    try {
+        while (currentToken().type != EOF_TOKEN) {
+            try {
+                if (currentToken().type == INT) {
+                    program->children.push_back(parseFunctionDefinition());
+                } else if (currentToken().type == VOID && !hasMain) {
+                    program->children.push_back(parseMainFunction());
+                    hasMain = true;
+                } else if (currentToken().type == VOID) {
+                    throw ParseError(currentToken(), "main function is already defined");
+                } else {
+                    throw ParseError(currentToken(), "Expected a function definition or void main() but got " + 
+                                                     describe(currentToken()));
+                }
+            } catch (const ParseError& error) {
+                report(error);
+                synchronizeTopLevel();
+            }
+        }
+    } catch (...) {
+        delete program;
+        throw;
+    }
+    return program;
+}
+
+bool Parser::parseStatementRange(size_t first, size_t stop, std::vector<ASTNode*>& statements) {
+    pos = first;
+    diagnostics.clear();
+    try {
+        while (pos < stop && currentToken().type != RBRACE && currentToken().type != EOF_TOKEN) {
+            try {
+                statements.push_back(parseStatement());
+            } catch (const ParseError& error) {
+                report(error);
+                synchronize();
+            }
+        }
+    } catch (const SyntaxError&) {
+        pos = stop + 1;
+    }
+    if (pos != stop) {
+        for (auto stmt : statements) delete stmt;
+        statements.clear();
+        return false;
+    }
+    return true;
+}
+
+ASTNode* Parser::parse() {
+    ASTNode* program = parseProgram();
+    if (!diagnostics.empty()) {
+        delete program;
+        throw SyntaxError(diagnostics);
+    }
+    for (auto child : program->children) {
+        if (child->type == MAIN_FUNCTION_NODE) {
+            return program;
+        }
+    }
+    delete program;
+    throw std::runtime_error("Error: couldn't find main function. Make sure to define it as void main() {");
+}
+
+size_t IncrementalDocument::tokenStartingAt(size_t offset) const {
+    size_t low = 0, high = tokenList.size();
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (tokenList[mid].start < offset) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+size_t IncrementalDocument::tokenEndingAt(size_t offset) const {
+    size_t low = 0, high = tokenList.size();
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (tokenList[mid].end < offset) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+void IncrementalDocument::relexAll() {
+    Lexer lexer(source);
+    try {
+        tokenList = lexer.tokenize();
+    } catch (const std::runtime_error& error) {
+        // Only an unterminated string stops the lexer; the document has
+        // no tokens (and no tree) until it is fixed
+        tokenList.clear();
+        diagnosticList = {{lexer.currentLine(), lexer.currentColumn(), error.what(), lexer.offset()}};
+    }
+    relexedTokens = tokenList.size();
+}
+
+void IncrementalDocument::reparseAll() {
+    delete ast;
+    ast = nullptr;
+    fullReparse = true;
+    reparsedStatements = 0;
+    if (tokenList.empty()) {
+        return;
+    }
+    Parser parser(tokenList);
+    try {
+        ast = parser.parseProgram();
+        diagnosticList = parser.getDiagnostics();
+    } catch (const SyntaxError& error) {
+        diagnosticList = error.diagnostics;
+    }
+}
+
+void IncrementalDocument::relex(size_t start, size_t oldEnd, long long delta, size_t& firstUnchanged) {
+    resyncLine = lineShift = columnShift = 0;
+    size_t first = tokenEndingAt(start);
+    Lexer lexer(source);
+    if (first > 0) {
+        first--;
+        lexer.seek(tokenList[first].start, tokenList[first].line, tokenList[first].column);
+    }
+    size_t old = tokenStartingAt(oldEnd);
+    std::vector<Token> fresh;
+    while (true) {
+        size_t count = fresh.size();
+        if (!lexer.lexNext(fresh)) {
+            fresh.push_back(lexer.endOfFile());
+        }
+        if (fresh.size() == count) {
+            continue;  // comment
+        }
+        const Token& token = fresh.back();
+        while (old < tokenList.size() && shifted(tokenList[old].start, oldEnd, delta) < token.start) {
+            old++;
+        }
+        if (old < tokenList.size() && shifted(tokenList[old].start, oldEnd, delta) == token.start &&
+            tokenList[old].type == token.type && tokenList[old].value == token.value) {
+            break;
+        }
+        if (token.type == EOF_TOKEN) {
+            old = tokenList.size();
+            break;
+        }
+    }
+    
+    if (old < tokenList.size()) {
+        // Back in step: shift the remaining old tokens into place
+        const Token& resync = fresh.back();
+        resyncLine = tokenList[old].line;
+        lineShift = resync.line - resyncLine;
+        columnShift = resync.column - tokenList[old].column;
+        fresh.pop_back();
+        for (size_t i = old; i < tokenList.size(); i++) {
+            Token& token = tokenList[i];
+            if (token.line == resyncLine) token.column += columnShift;
+            token.line += lineShift;
+            token.start = shifted(token.start, oldEnd, delta);
+            token.end = shifted(token.end, oldEnd, delta);
+        }
+    }
+    // Overwrite in place where possible; typing inside a token usually
+    // replaces it with exactly one new token
+    size_t replaced = old - first;
+    size_t common = std::min(replaced, fresh.size());
+    std::move(fresh.begin(), fresh.begin() + common, tokenList.begin() + first);
+    if (fresh.size() > replaced) {
+        tokenList.insert(tokenList.begin() + old, std::make_move_iterator(fresh.begin() + common),
+                         std::make_move_iterator(fresh.end()));
+    } else {
+        tokenList.erase(tokenList.begin() + first + common, tokenList.begin() + old);
+    }
+    relexedTokens = fresh.size();
+    firstUnchanged = first + fresh.size();
+}
+
+bool IncrementalDocument::reparse(size_t start, size_t oldEnd, long long delta, size_t firstUnchanged) {
+    // Tokens before the edit are unchanged, so old offsets still find them
+    ASTNode* list = nullptr;
+    size_t contentStart = 0;
+    ASTNode* node = ast;
+    while (true) {
+        ASTNode* next = nullptr;
+        for (auto child : node->children) {
+            if (hasRange(child) && child->start < start && oldEnd < child->end) {
+                next = child;
+                break;
+            }
+        }
+        if (!next) break;
+        if (isStatementList(next)) {
+            size_t open = tokenStartingAt(next->start);
+            while (open < tokenList.size() && tokenList[open].type != LBRACE) open++;
+            if (open < tokenList.size() && tokenList[open].end <= start && oldEnd < next->end) {
+                list = next;
+                contentStart = tokenList[open].end;
+            }
+        }
+        node = next;
+    }
+    if (!list) {
+        return false;
+    }
+    
+    // Statements touching the edit, or the gap it falls in. The statement
+    // before is redone too: an if peeks past its end for an `else`.
+    std::vector<ASTNode*>& children = list->children;
+    size_t first = 0;
+    while (first < children.size() && children[first]->end < start) first++;
+    size_t last = first;
+    if (first > 0) first--;
+    while (last < children.size() && children[last]->start <= oldEnd) last++;
+    
+    size_t regionStart = first > 0 ? children[first - 1]->end : contentStart;
+    size_t oldRegionEnd = last < children.size() ? children[last]->start : list->end - 1;
+    size_t regionEnd = shifted(oldRegionEnd, oldEnd, delta);
+    size_t firstToken = tokenStartingAt(regionStart);
+    size_t stopToken = tokenStartingAt(regionEnd);
+    if (stopToken < firstUnchanged || stopToken >= tokenList.size() || tokenList[stopToken].start != regionEnd) {
+        return false;
+    }
+    
+    Parser parser(tokenList);
+    std::vector<ASTNode*> statements;
+    if (!parser.parseStatementRange(firstToken, stopToken, statements)) {
+        return false;
+    }
+    
+    for (size_t i = first; i < last; i++) {
+        delete children[i];
+    }
+    children.erase(children.begin() + first, children.begin() + last);
+    
+    // Shift everything after the edit. Subtrees that end before it are
+    // untouched, and expressions (no range) never contain statements.
+    // Nodes starting after it move with their first token, which relex()
+    // kept.
+    std::vector<ASTNode*> pending(ast->children.begin(), ast->children.end());
+    while (!pending.empty()) {
+        ASTNode* next = pending.back();
+        pending.pop_back();
+        if (!hasRange(next) || next->end < oldEnd) {
+            continue;
+        }
+        if (next->start >= oldEnd) {
+            next->start = shifted(next->start, oldEnd, delta);
+            if (next->line == resyncLine) next->column += columnShift;
+            next->line += lineShift;
+        }
+        next->end = shifted(next->end, oldEnd, delta);
+        pending.insert(pending.end(), next->children.begin(), next->children.end());
+    }
+    children.insert(children.begin() + first, statements.begin(), statements.end());
+    
+    // Replace the region's diagnostics (an error at the end of the region,
+    // e.g. a missing ';' before '}', belongs to it), move later ones along
+    std::vector<Diagnostic> updated;
+    for (auto diagnostic : diagnosticList) {
+        if (diagnostic.offset >= regionStart && diagnostic.offset <= oldRegionEnd) {
+            continue;
+        }
+        if (diagnostic.offset >= oldEnd) {
+            diagnostic.offset = shifted(diagnostic.offset, oldEnd, delta);
+            size_t at = std::min(tokenStartingAt(diagnostic.offset), tokenList.size() - 1);
+            diagnostic.line = tokenList[at].line;
+            diagnostic.column = tokenList[at].column;
+        }
+        updated.push_back(diagnostic);
+    }
+    updated.insert(updated.end(), parser.getDiagnostics().begin(), parser.getDiagnostics().end());
+    std::stable_sort(updated.begin(), updated.end(), [](const Diagnostic& a, const Diagnostic& b) {
+        return a.offset < b.offset;
+    });
+    diagnosticList = std::move(updated);
+    
+    reparsedStatements = statements.size();
+    fullReparse = false;
+    return true;
+}
+
+void IncrementalDocument::setText(const std::string& text) {
+    source = text;
+    diagnosticList.clear();
+    relexAll();
+    reparseAll();
+}
+
+void IncrementalDocument::applyEdit(size_t start, size_t end, const std::string& replacement) {
+    if (start > end || end > source.length()) {
+        throw std::out_of_range("Edit range is outside the document");
+    }
+    long long delta = static_cast<long long>(replacement.length()) - static_cast<long long>(end - start);
+    source.replace(start, end - start, replacement);
+    
+    if (tokenList.empty()) {
+        diagnosticList.clear();
+        relexAll();
+        reparseAll();
+        return;
+    }
+    
+    size_t firstUnchanged = 0;
+    try {
+        relex(start, end, delta, firstUnchanged);
+    } catch (const std::runtime_error&) {
+        relexAll();
+        reparseAll();
+        return;
+    }
+    if (!ast || !reparse(start, end, delta, firstUnchanged)) {
+        reparseAll();
+    }
+}
+
+int Optimizer::countNodes(ASTNode* node, int limit) {
+    int count = 0;
+    std::vector<ASTNode*> pending{node};
+    while (!pending.empty() && count <= limit) {
+        ASTNode* next = pending.back();
+        pending.pop_back();
+        count++;
+        pending.insert(pending.end(), next->children.begin(), next->children.end());
+    }
+    return count;
+}
+
+bool Optimizer::onlyReadsParams(ASTNode* node, const std::set<std::string>& params) {
+    switch (node->type) {
+        case NUMBER_NODE:
+        case STRING_NODE:
+            return true;
+        case VARIABLE_NODE:
+            return params.count(node->value) > 0;
+        case ARITHMETIC_NODE:
+        case COMPARISON_NODE:
+        case LOGICAL_NODE:
+        case UNARY_NODE:
+            for (auto child : node->children) {
+                if (!onlyReadsParams(child, params)) return false;
+            }
+            return true;
+        default:
+            return false;
+    }
+}
+
+ASTNode* Optimizer::clone(ASTNode* node) {
+    ASTNode* copy = new ASTNode(node->type, node->value);
+    for (auto child : node->children) {
+        copy->children.push_back(clone(child));
+    }
+    return copy;
+}
+
+ASTNode* Optimizer::substitute(ASTNode* node, ASTNode* funcDef, ASTNode* call) {
+    if (node->type == VARIABLE_NODE) {
+        for (size_t i = 0; i + 1 < funcDef->children.size(); i++) {
+            if (funcDef->children[i]->value == node->value) {
+                return clone(call->children[i]);
+            }
+        }
+    }
+    ASTNode* copy = new ASTNode(node->type, node->value);
+    for (auto child : node->children) {
+        copy->children.push_back(substitute(child, funcDef, call));
+    }
+    return copy;
+}
+
+void Optimizer::inlineCall(ASTNode*& node) {
+    if (node->type != FUNCTION_CALL_NODE) {
+        return;
+    }
+    auto it = inlineable.find(node->value);
+    if (it == inlineable.end() || node->children.size() != it->second->children.size() - 1) {
+        return;
+    }
+    for (auto arg : node->children) {
+        if (!isTrivialArgument(arg)) return;
+    }
+    
+    ASTNode* funcDef = it->second;
+    ASTNode* returned = funcDef->children.back()->children[0]->children[0];
+    ASTNode* inlined = substitute(returned, funcDef, node);
+    delete node;
+    node = inlined;
+}
+
+void Optimizer::inlineCalls(ASTNode*& root) {
+    std::vector<std::pair<ASTNode**, bool>> pending{{&root, false}};
+    while (!pending.empty()) {
+        ASTNode** slot = pending.back().first;
+        if (pending.back().second) {
+            pending.pop_back();
+            inlineCall(*slot);
+            continue;
+        }
+        pending.back().second = true;
+        std::vector<ASTNode*>& children = (*slot)->children;
+        for (auto child = children.rbegin(); child != children.rend(); ++child) {
+            pending.push_back({&*child, false});
+        }
+    }
+}
+
+void Optimizer::optimize(ASTNode* program) {
+    inlineable.clear();
+    for (auto func : program->children) {
+        if (func->type != FUNCTION_DEF_NODE) continue;
+        
+        ASTNode* body = func->children.back();
+        if (body->type != BLOCK_NODE || body->children.size() != 1 ||
+            body->children[0]->type != RETURN_NODE || body->children[0]->children.empty()) {
+            continue;
+        }
+        std::set<std::string> params;
+        for (size_t i = 0; i + 1 < func->children.size(); i++) {
+            params.insert(func->children[i]->value);
+        }
+        ASTNode* returned = body->children[0]->children[0];
+        if (countNodes(returned, MAX_INLINE_NODES) <= MAX_INLINE_NODES && onlyReadsParams(returned, params)) {
+            inlineable[func->value] = func;
+        }
+    }
+    
+    for (auto& func : program->children) {
+        inlineCalls(func);
+    }
+}
+
+Value::Value(ASTNode* n) {
+    switch (n->type) {
+        case NUMBER_NODE:
+            type = INT;
+            intValue = std::stoi(n->value);  // convert from string to int
+            break;
+        case STRING_NODE:
+            type = STRING;
+            stringValue = n->value;
+            break;
+        default:
+            throw std::runtime_error("ASTNode type not convertible to Value");
+    }
+}
+
+bool Evaluator::isExpression(ASTNode* node) {
+    switch (node->type) {
+        case ARITHMETIC_NODE: case COMPARISON_NODE: case LOGICAL_NODE: case UNARY_NODE:
+        case NUMBER_NODE: case STRING_NODE:
+        case VARIABLE_NODE: case INDEX_NODE: case FUNCTION_CALL_NODE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool Evaluator::writesVariable(ASTNode* node, const std::string& name) {
+    return anyNode(node, [&](ASTNode* n) {
+        return (n->type == ASSIGNMENT_NODE || n->type == VARIABLE_DECL_NODE ||
+                n->type == STRING_DECL_NODE) && n->value == name;
+    });
+}
+
+int Evaluator::declare(std::map<std::string, int>& slots, const std::string& name) {
+    auto it = slots.find(name);
+    if (it != slots.end()) {
+        return it->second;
+    }
+    int slot = static_cast<int>(slots.size());
+    slots[name] = slot;
+    return slot;
+}
+
+void Evaluator::resolve(ASTNode* root, Scope& scope) {
+    std::vector<std::pair<ASTNode*, bool>> pending{{root, false}};
+    while (!pending.empty()) {
+        ASTNode* node = pending.back().first;
+        bool childrenDone = pending.back().second;
+        pending.pop_back();
+        
+        if (childrenDone) {
+            node->slot = declare(scope.locals, node->value);
+            continue;
+        }
+        
+        switch (node->type) {
+            case VARIABLE_DECL_NODE:
+            case STRING_DECL_NODE:
+                pending.push_back({node, true});
+                break;
+            
+            case ARRAY_DECL_NODE:
+                node->slot = declare(scope.arrays, node->value);
+                continue;
+            
+            case VARIABLE_NODE:
+            case ASSIGNMENT_NODE: {
+                auto it = scope.locals.find(node->value);
+                if (it == scope.locals.end()) {
+                    throw std::runtime_error("Undefined variable: " + node->value);
+                }
+                node->slot = it->second;
+                break;
+            }
+            
+            case INDEX_NODE:
+            case ARRAY_ASSIGN_NODE: {
+                auto it = scope.arrays.find(node->value);
+                if (it == scope.arrays.end()) {
+                    throw std::runtime_error("Undefined array: " + node->value);
+                }
+                node->slot = it->second;
+                break;
+            }
+            
+            case FUNCTION_CALL_NODE: {
+                auto it = functionIndex.find(node->value);
+                node->slot = it != functionIndex.end() ? it->second : -1;
+                break;
+            }
+            
+            default:
+                break;
+        }
+        for (auto child = node->children.rbegin(); child != node->children.rend(); ++child) {
+            pending.push_back({*child, false});
+        }
+    }
+}
+
+Evaluator::Function& Evaluator::load(ASTNode* program) {
+    functions.clear();
+    functionIndex.clear();
+    countedLoops.clear();
+    
+    int mainIndex = -1;
+    for (auto child : program->children) {
+        std::string name = child->type == MAIN_FUNCTION_NODE ? "main" : child->value;
+        if (isBuiltin(name) || functionIndex.count(name)) {
+            throw std::runtime_error("Function '" + name + "' is already defined");
+        }
+        Function function;
+        function.node = child;
+        functionIndex[name] = static_cast<int>(functions.size());
+        if (child->type == MAIN_FUNCTION_NODE) {
+            mainIndex = static_cast<int>(functions.size());
+        }
+        functions.push_back(function);
+    }
+    if (mainIndex < 0) {
+        throw std::runtime_error("Error: couldn't find main function. Make sure to define it as void main() {");
+    }
+    
+    for (auto& function : functions) {
+        resolveFunction(function);
+    }
+    return functions[mainIndex];
+}
+
+void Evaluator::resolveFunction(Function& function) {
+    Scope scope;
+    ASTNode* node = function.node;
+    if (node->type == FUNCTION_DEF_NODE) {
+        // Parameters come first, followed by the body block
+        function.paramCount = node->children.size() - 1;
+        for (size_t i = 0; i < function.paramCount; i++) {
+            node->children[i]->slot = declare(scope.locals, node->children[i]->value);
+        }
+        if (scope.locals.size() != function.paramCount) {
+            throw std::runtime_error("Duplicate parameter name in function '" + node->value + "'");
+        }
+        resolve(node->children.back(), scope);
+    } else {
+        for (auto child : node->children) {
+            resolve(child, scope);
+        }
+    }
+    function.localCount = scope.locals.size();
+    function.arrayCount = scope.arrays.size();
+}
+
+Evaluator::Frame Evaluator::makeFrame(const Function& function) {
+    Frame frame;
+    frame.function = function.node;
+    frame.locals.resize(function.localCount);
+    frame.arrays.resize(function.arrayCount);
+    return frame;
+}
+
+void Evaluator::push(ASTNode* node, bool discard) {
+    if (tasks.size() >= maxTasks) {
+        throw std::runtime_error("Evaluation stack limit exceeded (" + std::to_string(maxTasks) + " entries)");
+    }
+    tasks.push_back(Task{node, 0, discard, nullptr, 0, 0, UNKNOWN});
+}
+
+void Evaluator::pushOperands(ASTNode* node, size_t first, size_t count) {
+    for (size_t i = first + count; i > first; i--) {
+        if (!isLeaf(node->children[i - 1])) {
+            push(node->children[i - 1]);
+        }
+    }
+}
+
+size_t Evaluator::pendingOperands(ASTNode* node, size_t first, size_t count) {
+    size_t pending = 0;
+    for (size_t i = first; i < first + count; i++) {
+        if (!isLeaf(node->children[i])) pending++;
+    }
+    return pending;
+}
+
+const Value& Evaluator::leafOperand(ASTNode* node, Value& scratch) {
+    if (node->type == VARIABLE_NODE) {
+        return frames.back().locals[node->slot];
+    }
+    scratch = node->type == NUMBER_NODE ? Value(std::stoi(node->value)) : Value(node->value);
+    return scratch;
+}
+
+const Value& Evaluator::operand(ASTNode* child, size_t& cursor, Value& scratch) {
+    if (isLeaf(child)) {
+        return leafOperand(child, scratch);
+    }
+    return values[cursor++];
+}
+
+Value Evaluator::popOperand(ASTNode* child) {
+    if (isLeaf(child)) {
+        Value scratch;
+        return leafOperand(child, scratch);
+    }
+    Value value = std::move(values.back());
+    values.pop_back();
+    return value;
+}
+
+void Evaluator::finish(Value&& result) {
+    bool discard = tasks.back().discard;
+    tasks.pop_back();
+    if (!discard) {
+        values.push_back(std::move(result));
+    }
+}
+
+int& Evaluator::element(ASTNode* node, const Value& index) {
+    if (index.type != Value::INT) {
+        throw std::runtime_error("Array index must be integer");
+    }
+    std::vector<int>& storage = frames.back().arrays[node->slot];
+    if (storage.empty()) {
+        throw std::runtime_error("Array used before declaration: " + node->value);
+    }
+    if (boundsChecks && (index.intValue < 0 || index.intValue >= static_cast<int>(storage.size()))) {
+        throw std::runtime_error("Array index out of bounds: " + node->value + "[" + 
+                                 std::to_string(index.intValue) + "] (size " + 
+                                 std::to_string(storage.size()) + ")");
+    }
+    return storage[index.intValue];
+}
+
+void Evaluator::appendString(std::string& target, const Value& value) {
+    if (value.type == Value::STRING) {
+        target += value.stringValue;
+    } else {
+        target += std::to_string(value.intValue);
+    }
+}
+
+std::vector<ASTNode*> Evaluator::appendPieces(ASTNode* node) {
+    std::vector<ASTNode*> pieces;
+    ASTNode* spine = node->children[0];
+    while (spine->type == ARITHMETIC_NODE && spine->value == "+") {
+        pieces.push_back(spine->children[1]);
+        spine = spine->children[0];
+    }
+    if (spine->type != VARIABLE_NODE || spine->slot != node->slot) {
+        pieces.clear();
+    }
+    return pieces;
+}
+
+bool Evaluator::scheduleAppend(ASTNode* node) {
+    if (frames.back().locals[node->slot].type != Value::STRING) {
+        return false;
+    }
+    std::vector<ASTNode*> pieces = appendPieces(node);
+    if (pieces.empty()) {
+        return false;
+    }
+    for (auto piece : pieces) {
+        if (readsVariable(piece, node->value)) return false;
+    }
+    tasks.back().stage = 2;
+    for (auto piece : pieces) {
+        if (!isLeaf(piece)) push(piece);
+    }
+    return true;
+}
+
+void Evaluator::finishAppend(ASTNode* node) {
+    std::vector<ASTNode*> pieces = appendPieces(node);
+    size_t pending = 0;
+    for (auto piece : pieces) {
+        if (!isLeaf(piece)) pending++;
+    }
+    size_t base = values.size() - pending;
+    size_t cursor = base;
+    std::string& target = frames.back().locals[node->slot].stringValue;
+    for (auto piece = pieces.rbegin(); piece != pieces.rend(); ++piece) {
+        Value scratch;
+        appendString(target, operand(*piece, cursor, scratch));
+    }
+    values.resize(base);
+    tasks.pop_back();
+}
+
+const Evaluator::CountedLoop& Evaluator::analyzeForLoop(ASTNode* node) {
+    auto cached = countedLoops.find(node);
+    if (cached != countedLoops.end()) {
+        return cached->second;
+    }
+    
+    CountedLoop& loop = countedLoops[node];
+    ASTNode* condition = node->children[1];
+    ASTNode* step = node->children[2];
+    ASTNode* body = node->children[3];
+    
+    if (condition->type != COMPARISON_NODE || condition->value == "==" ||
+        condition->children[0]->type != VARIABLE_NODE) {
+        return loop;
+    }
+    const std::string& counter = condition->children[0]->value;
+    ASTNode* bound = condition->children[1];
+    if (bound->type != NUMBER_NODE &&
+        (bound->type != VARIABLE_NODE || bound->value == counter ||
+         writesVariable(body, bound->value))) {
+        return loop;
+    }
+    
+    if (step->type != ASSIGNMENT_NODE || step->value != counter) {
+        return loop;
+    }
+    ASTNode* increment = step->children[0];
+    if (increment->type != ARITHMETIC_NODE || (increment->value != "+" && increment->value != "-") ||
+        increment->children[0]->type != VARIABLE_NODE || increment->children[0]->value != counter ||
+        increment->children[1]->type != NUMBER_NODE) {
+        return loop;
+    }
+    int amount = std::stoi(increment->children[1]->value);
+    if (amount == 0 || writesVariable(body, counter)) {
+        return loop;
+    }
+    
+    loop.counted = true;
+    if (condition->value == "<") loop.op = LESS_THAN;
+    else if (condition->value == "<=") loop.op = LESS_THAN_OR_EQUAL;
+    else if (condition->value == ">") loop.op = GREATER_THAN;
+    else if (condition->value == ">=") loop.op = GREATER_THAN_OR_EQUAL;
+    else loop.op = NOT_EQUAL;
+    loop.step = increment->value == "+" ? amount : -amount;
+    return loop;
+}
+
+bool Evaluator::startCountedLoop(Task& task) {
+    const CountedLoop& loop = analyzeForLoop(task.node);
+    if (!loop.counted) {
+        return false;
+    }
+    ASTNode* condition = task.node->children[1];
+    Value& counterValue = frames.back().locals[condition->children[0]->slot];
+    Value boundScratch;
+    const Value& bound = leafOperand(condition->children[1], boundScratch);
+    if (counterValue.type != Value::INT || bound.type != Value::INT) {
+        return false;
+    }
+    
+    // Frame locals never move while the frame is active, and the body
+    // never writes the bound, so it can be captured once
+    task.counter = &counterValue.intValue;
+    task.limit = bound.intValue;
+    task.step = loop.step;
+    task.op = loop.op;
+    return true;
+}
+
+bool Evaluator::countedLoopContinues(const Task& task) {
+    switch (task.op) {
+        case LESS_THAN: return *task.counter < task.limit;
+        case LESS_THAN_OR_EQUAL: return *task.counter <= task.limit;
+        case GREATER_THAN: return *task.counter > task.limit;
+        case GREATER_THAN_OR_EQUAL: return *task.counter >= task.limit;
+        default: return *task.counter != task.limit;
+    }
+}
+
+bool Evaluator::isTrue(const Value& condition, const char* error) {
+    if (condition.type != Value::INT) {
+        throw std::runtime_error(error);
+    }
+    return condition.intValue != 0;
+}
+
+Evaluator::Frame Evaluator::argumentFrame(ASTNode* call) {
+    const Function& function = functions[call->slot];
+    Frame frame = makeFrame(function);
+    size_t base = values.size() - pendingOperands(call, 0, call->children.size());
+    size_t cursor = base;
+    for (size_t i = 0; i < call->children.size(); i++) {
+        ASTNode* arg = call->children[i];
+        if (isLeaf(arg)) {
+            Value scratch;
+            frame.locals[i] = leafOperand(arg, scratch);
+        } else {
+            frame.locals[i] = std::move(values[cursor++]);
+        }
+    }
+    values.resize(base);
+    return frame;
+}
+
+void Evaluator::checkCall(ASTNode* call) {
+    if (call->slot >= 0) {
+        const Function& function = functions[call->slot];
+        if (call->children.size() != function.paramCount) {
+            throw std::runtime_error("Function '" + call->value + "' expects " + 
+                                     std::to_string(function.paramCount) + " argument(s)");
+        }
+    } else if (!isBuiltin(call->value)) {
+        throw std::runtime_error("Unknown function: " + call->value);
+    } else if (call->children.size() != 1) {
+        std::string name = call->value == "printa" ? "print" : call->value;
+        throw std::runtime_error(name + "() function expects exactly 1 argument");
+    }
+}
+
+Value Evaluator::compileFile(const std::string& filename) {
+    // Stamped before reading, so a write while it's read isn't mistaken for this version
+    CompileCache::Stamp stamp;
+    bool stamped = compileCache && CompileCache::stamp(filename, stamp);
+    const std::string* cached = stamped ? compileCache->find(filename, stamp) : nullptr;
+    std::string cppCode;
+    if (cached) {
+        cppCode = *cached;
+    } else {
+        // Read source file
+        std::ifstream file(filename);
+        if (!file.is_open()) {
+            throw std::runtime_error("Could not open file: " + filename);
+        }
+        
+        std::string sourceCode;
+        std::string line;
+        while (std::getline(file, line)) {
+            sourceCode += line + "\n";
+        }
+        file.close();
+        
+        // Compile to C++
+        Lexer lexer(sourceCode, *out);
+        std::vector<Token> tokens = lexer.tokenize();
+        Parser parser(tokens);
+        std::unique_ptr<ASTNode> ast(parser.parse());
+        Optimizer().optimize(ast.get());
+        
+        // Generate C++ code
+        cppCode = generateCppCode(ast.get());
+        if (stamped) {
+            compileCache->store(filename, stamp, cppCode);
+        }
+    }
+    
+    // Write to output file
+    std::string outputName = filename;
+    size_t dotPos = outputName.find_last_of('.');
+    if (dotPos != std::string::npos) {
+        outputName = outputName.substr(0, dotPos);
+    }
+    outputName += ".cpp";
+    
+    std::ofstream outFile(outputName);
+    outFile << cppCode;
+    outFile.close();
+    
+    *out << "Compiled " << filename << " to " << outputName << std::endl;
+    return Value(0);
+}
+
+Value Evaluator::callBuiltin(ASTNode* node, const Value& arg, bool wantResult) {
+    if (node->value == "printa") {
+        if (arg.type == Value::INT) {
+            *out << arg.intValue;
+        } else {
+            *out << arg.stringValue;
+        }
+        return wantResult ? arg : Value(0);
+    } else if (node->value == "len") {
+        if (arg.type != Value::STRING) {
+            throw std::runtime_error("len() function expects string argument");
+        }
+        return Value(static_cast<int>(arg.stringValue.length()));
+    } else {
+        if (arg.type != Value::STRING) {
+            throw std::runtime_error("compile() function expects string argument");
+        }
+        return compileFile(arg.stringValue);
+    }
+}
+
+Value Evaluator::arithmetic(ASTNode* node, const Value& left, const Value& right) {
+    if (node->value == "+" && (left.type == Value::STRING || right.type == Value::STRING)) {
+        std::string result = left.type == Value::STRING ? left.stringValue : std::to_string(left.intValue);
+        appendString(result, right);
+        return Value(std::move(result));
+    }
+    if (left.type != Value::INT || right.type != Value::INT) {
+        throw std::runtime_error("Arithmetic operations only supported on numbers");
+    }
+    
+    if (node->value == "+") return Value(left.intValue + right.intValue);
+    if (node->value == "-") return Value(left.intValue - right.intValue);
+    if (node->value == "*") return Value(left.intValue * right.intValue);
+    if (node->value == "/") {
+        if (right.intValue == 0) throw std::runtime_error("Division by zero");
+        return Value(left.intValue / right.intValue);
+    }
+    if (node->value == "%") {
+        if (right.intValue == 0) throw std::runtime_error("Modulo by zero");
+        return Value(left.intValue % right.intValue);
+    }
+    throw std::runtime_error("Unknown arithmetic operator: " + node->value);
+}
+
+Value Evaluator::comparison(ASTNode* node, const Value& left, const Value& right) {
+    if (left.type == Value::STRING && right.type == Value::STRING) {
+        if (node->value == "==") return Value(left.stringValue == right.stringValue ? 1 : 0);
+        if (node->value == "!=") return Value(left.stringValue != right.stringValue ? 1 : 0);
+        throw std::runtime_error("Only == and != are supported on strings");
+    }
+    if (left.type != Value::INT || right.type != Value::INT) {
+        throw std::runtime_error("Comparison operations only supported on integers");
+    }
+    
+    if (node->value == "==") return Value(left.intValue == right.intValue ? 1 : 0);
+    if (node->value == "!=") return Value(left.intValue != right.intValue ? 1 : 0);
+    if (node->value == "<") return Value(left.intValue < right.intValue ? 1 : 0);
+    if (node->value == ">") return Value(left.intValue > right.intValue ? 1 : 0);
+	if (node->value == "<=") return Value(left.intValue <= right.intValue ? 1 : 0);
+	if (node->value == ">=") return Value(left.intValue >= right.intValue ? 1 : 0);
+    
+    throw std::runtime_error("Unknown comparison operator: " + node->value);
+}
+
+void Evaluator::step() {
+    Task& task = tasks.back();
+    ASTNode* node = task.node;
+    
+    switch (node->type) {
+        case MAIN_FUNCTION_NODE:
+        case BLOCK_NODE: {
+            size_t index = task.stage;
+            if (index >= node->children.size()) {
+                tasks.pop_back();
+                return;
+            }
+            if (index + 1 == node->children.size()) {
+                // Tail position: the last statement takes over the block's
+                // stack entry, so nesting does not grow the stack
+                tasks.pop_back();
+            } else {
+                task.stage++;
+            }
+            pushStatement(node->children[index]);
+            return;
+        }
+        
+        case VARIABLE_DECL_NODE:
+        case STRING_DECL_NODE:
+        case ASSIGNMENT_NODE: {
+            if (node->children.empty()) {
+                if (node->type == VARIABLE_DECL_NODE) {
+		        *errors << "Warning: variable '" << node->value <<"' declared without initialization (defaulting to 0)\n";
+                    frames.back().locals[node->slot] = Value(0);
+                } else {
+                    frames.back().locals[node->slot] = Value(std::string());
+                }
+                tasks.pop_back();
+                return;
+            }
+            if (task.stage == 0) {
+                if (node->type == ASSIGNMENT_NODE && scheduleAppend(node)) {
+                    return;
+                }
+                task.stage = 1;
+                pushOperands(node, 0, 1);
+                return;
+            }
+            if (task.stage == 2) {
+                finishAppend(node);
+                return;
+            }
+            // Stores move the computed value into the variable's frame slot
+            frames.back().locals[node->slot] = popOperand(node->children[0]);
+            tasks.pop_back();
+            return;
+        }
+        
+        case ARRAY_DECL_NODE: {
+            int size = std::stoi(node->children[0]->value);
+            if (size <= 0) {
+                throw std::runtime_error("Array size must be positive: " + node->value);
+            }
+            frames.back().arrays[node->slot].assign(size, 0);
+            tasks.pop_back();
+            return;
+        }
+        
+        case ARRAY_ASSIGN_NODE: {
+            if (task.stage == 0) {
+                task.stage = 1;
+                pushOperands(node, 0, 2);
+                return;
+            }
+            size_t base = values.size() - pendingOperands(node, 0, 2);
+            size_t cursor = base;
+            Value indexScratch, valueScratch;
+            const Value& index = operand(node->children[0], cursor, indexScratch);
+            const Value& value = operand(node->children[1], cursor, valueScratch);
+            if (value.type != Value::INT) {
+                throw std::runtime_error("Array elements must be integers");
+            }
+            element(node, index) = value.intValue;
+            values.resize(base);
+            tasks.pop_back();
+            return;
+        }
+        
+        case INDEX_NODE: {
+            if (task.stage == 0) {
+                task.stage = 1;
+                pushOperands(node, 0, 1);
+                return;
+            }
+            Value index = popOperand(node->children[0]);
+            finish(Value(element(node, index)));
+            return;
+        }
+        
+        case IF_NODE: {
+            if (task.stage == 0) {
+                task.stage = 1;
+                pushOperands(node, 0, 1);
+                return;
+            }
+            bool taken = isTrue(popOperand(node->children[0]), "If condition must be integer");
+            // The chosen branch replaces the if on the stack (tail position)
+            tasks.pop_back();
+            if (taken) {
+                pushStatement(node->children[1]);
+            } else if (node->children.size() > 2) {
+                pushStatement(node->children[2]);
+            }
+            return;
+        }
+        
+        case WHILE_NODE: {
+            if (task.stage == 0) {
+                task.stage = 1;
+                pushOperands(node, 0, 1);
+                return;
+            }
+            Value condition = popOperand(node->children[0]);
+            if (condition.type != Value::INT || condition.intValue == 0) {
+                tasks.pop_back();
+                return;
+            }
+            task.stage = 0;
+            pushStatement(node->children[1]);
+            return;
+        }
+        
+        case FOR_NODE: {
+            switch (task.stage) {
+                case FOR_INIT:
+                    task.stage = FOR_START;
+                    pushStatement(node->children[0]);
+                    return;
+                case FOR_START:
+                    task.stage = startCountedLoop(task) ? FOR_COUNTED_TEST : FOR_CONDITION;
+                    return;
+                case FOR_CONDITION:
+                    task.stage = FOR_TEST;
+                    pushOperands(node, 1, 1);
+                    return;
+                case FOR_TEST: {
+                    Value condition = popOperand(node->children[1]);
+                    if (condition.type != Value::INT || condition.intValue == 0) {
+                        tasks.pop_back();
+                        return;
+                    }
+                    task.stage = FOR_STEP;
+                    pushStatement(node->children[3]);
+                    return;
+                }
+                case FOR_STEP:
+                    task.stage = FOR_CONDITION;
+                    pushStatement(node->children[2]);
+                    return;
+                case FOR_COUNTED_TEST:
+                    if (!countedLoopContinues(task)) {
+                        tasks.pop_back();
+                        return;
+                    }
+                    task.stage = FOR_COUNTED_STEP;
+                    pushStatement(node->children[3]);
+                    return;
+                default:
+                    *task.counter += task.step;
+                    task.stage = FOR_COUNTED_TEST;
+                    return;
+            }
+        }
+        
+        case RETURN_NODE: {
+            if (node->children.empty()) {
+                returnFromFrame(Value(0));
+                return;
+            }
+            ASTNode* result = node->children[0];
+            if (task.stage == 0) {
+                if (result->type == FUNCTION_CALL_NODE && result->slot >= 0) {
+                    // Tail call: evaluate the arguments, then reuse this frame
+                    checkCall(result);
+                    task.stage = 2;
+                    pushOperands(result, 0, result->children.size());
+                    return;
+                }
+                task.stage = 1;
+                pushOperands(node, 0, 1);
+                return;
+            }
+            if (task.stage == 2) {
+                Frame frame = argumentFrame(result);
+                frame.taskBase = frames.back().taskBase;
+                frames.back() = std::move(frame);
+                tasks.resize(frames.back().taskBase);
+                push(functions[result->slot].node->children.back());
+                return;
+            }
+            returnFromFrame(popOperand(result));
+            return;
+        }
+        
+        case FUNCTION_CALL_NODE: {
+            if (task.stage == 0) {
+                checkCall(node);
+                task.stage = 1;
+                pushOperands(node, 0, node->children.size());
+                return;
+            }
+            if (task.stage == 2) {
+                // The callee's body has finished or returned
+                Value result = frames.back().returned ? std::move(returnValue) : Value(0);
+                frames.pop_back();
+                finish(std::move(result));
+                return;
+            }
+            if (node->slot < 0) {
+                size_t base = values.size() - pendingOperands(node, 0, 1);
+                size_t cursor = base;
+                Value scratch;
+                Value result = callBuiltin(node, operand(node->children[0], cursor, scratch), !task.discard);
+                values.resize(base);
+                finish(std::move(result));
+                return;
+            }
+            
+            // Calls a user-defined function: arguments were evaluated in the
+            // caller's frame, the callee runs in a fresh one until it returns
+            if (frames.size() >= maxFrames) {
+                throw std::runtime_error("Maximum call depth exceeded (" + std::to_string(maxFrames) + " frames)");
+            }
+            Frame frame = argumentFrame(node);
+            frame.taskBase = tasks.size();
+            task.stage = 2;
+            frames.push_back(std::move(frame));
+            push(functions[node->slot].node->children.back());
+            return;
+        }
+        
+        case ARITHMETIC_NODE:
+        case COMPARISON_NODE: {
+            if (task.stage == 0 && pendingOperands(node, 0, 2) > 0) {
+                task.stage = 1;
+                pushOperands(node, 0, 2);
+                return;
+            }
+            size_t base = values.size() - pendingOperands(node, 0, 2);
+            size_t cursor = base;
+            Value leftScratch, rightScratch;
+            const Value& left = operand(node->children[0], cursor, leftScratch);
+            const Value& right = operand(node->children[1], cursor, rightScratch);
+            
+            if (node->type == ARITHMETIC_NODE && node->value == "+" && 
+                !isLeaf(node->children[0]) && left.type == Value::STRING) {
+                // A temporary left operand is reused as the concatenation buffer,
+                // so a chain like a + b + c appends instead of copying each step
+                appendString(values[base].stringValue, right);
+                values.resize(base + 1);
+                Value result = std::move(values.back());
+                values.pop_back();
+                finish(std::move(result));
+                return;
+            }
+            
+            Value result = node->type == ARITHMETIC_NODE ? arithmetic(node, left, right)
+                                                         : comparison(node, left, right);
+            values.resize(base);
+            finish(std::move(result));
+            return;
+        }
+        
+        case LOGICAL_NODE: {
+            // && and || skip their right operand once the left decides the result
+            bool isAnd = node->value == "&&";
+            if (task.stage == 0) {
+                task.stage = 1;
+                if (!isLeaf(node->children[0])) {
+                    push(node->children[0]);
+                    return;
+                }
+            }
+            if (task.stage == 1) {
+                bool left = isTrue(popOperand(node->children[0]), "Logical operations only supported on integers");
+                if (left != isAnd) {
+                    finish(Value(left ? 1 : 0));
+                    return;
+                }
+                task.stage = 2;
+                if (!isLeaf(node->children[1])) {
+                    push(node->children[1]);
+                    return;
+                }
+            }
+            bool right = isTrue(popOperand(node->children[1]), "Logical operations only supported on integers");
+            finish(Value(right ? 1 : 0));
+            return;
+        }
+        
+        case UNARY_NODE: {
+            if (task.stage == 0 && !isLeaf(node->children[0])) {
+                task.stage = 1;
+                push(node->children[0]);
+                return;
+            }
+            Value value = popOperand(node->children[0]);
+            if (value.type != Value::INT) {
+                throw std::runtime_error("Unary minus only supported on integers");
+            }
+            finish(Value(-value.intValue));
+            return;
+        }
+        
+        case VARIABLE_NODE:
+        case NUMBER_NODE:
+        case STRING_NODE: {
+            Value scratch;
+            finish(Value(leafOperand(node, scratch)));
+            return;
+        }
+        
+        default: {
+            throw std::runtime_error("Unknown node type");
+        }
+    }
+}
+
+void Evaluator::runChecked(size_t baseDepth) {
+    auto lastSample = std::chrono::steady_clock::now();
+    unsigned countdown = CHECK_STEPS;
+    while (tasks.size() > baseDepth) {
+        const Task& task = tasks.back();
+        if (profile && task.stage == 0 && task.node->line > 0 && task.node->type != BLOCK_NODE &&
+            task.node->type != MAIN_FUNCTION_NODE) {
+            profile->countExecution(task.node->line);
+        }
+        step();
+        if (--countdown == 0) {
+            countdown = CHECK_STEPS;
+            if (cancelFlag && cancelFlag->load(std::memory_order_relaxed)) {
+                throw Interrupted();
+            }
+            if (profile) {
+                auto now = std::chrono::steady_clock::now();
+                if (now - lastSample >= profile->interval) {
+                    sampleProfile(std::chrono::duration<double>(now - lastSample).count());
+                    lastSample = now;
+                }
+            }
+        }
+    }
+}
+
+void Evaluator::sampleProfile(double elapsed) {
+    if (tasks.empty()) return;
+    std::string stack;
+    std::vector<int> seen;  // lines already charged, so recursion counts once
+    for (size_t k = 0; k < frames.size(); k++) {
+        if (frames.size() > MAX_PROFILE_FRAMES && k == MAX_PROFILE_FRAMES / 2) {
+            stack += "[...];";
+            k = frames.size() - MAX_PROFILE_FRAMES / 2;
+        }
+        // The innermost statement among this frame's tasks. Blocks only carry
+        // the line they open on (a function's is its definition), and
+        // expressions and nodes the optimizer made up have none.
+        size_t begin = frames[k].taskBase;
+        size_t end = k + 1 < frames.size() ? frames[k + 1].taskBase : tasks.size();
+        int line = 0;
+        for (size_t i = end; i > begin && line == 0; i--) {
+            ASTNode* node = tasks[i - 1].node;
+            if (node->type != BLOCK_NODE && node->type != MAIN_FUNCTION_NODE) {
+                line = node->line;
+            }
+        }
+        ASTNode* function = frames[k].function;
+        std::string name = function && function->type == FUNCTION_DEF_NODE ? function->value : "main";
+        // Just entered or about to return, no statement running: the function alone
+        stack += line > 0 ? name + ":" + std::to_string(line) + ";" : name + ";";
+        if (line > 0 && std::find(seen.begin(), seen.end(), line) == seen.end()) {
+            seen.push_back(line);
+            if (static_cast<size_t>(line) >= profile->lines.size()) profile->lines.resize(line + 1);
+            profile->lines[line].totalSeconds += elapsed;
+        }
+        if (k + 1 == frames.size() && line > 0) {
+            profile->lines[line].selfSeconds += elapsed;
+        }
+    }
+    stack.pop_back();
+    profile->stacks[stack] += elapsed;
+    profile->samples++;
+    profile->sampledSeconds += elapsed;
+}
+
+Value Evaluator::evaluate(ASTNode* node) {
+    if (node->type != PROGRAM_NODE) {
+        throw std::runtime_error("Evaluator expects a program node");
+    }
+    const Function& mainFunction = load(node);
+    tasks.clear();
+    values.clear();
+    frames.clear();
+    frames.push_back(makeFrame(mainFunction));
+    push(mainFunction.node);
+    run(0);
+    frames.clear();
+    return Value(0);
+}
+
+void Evaluator::defineFunction(ASTNode* definition) {
+    const std::string& name = definition->value;
+    if (isBuiltin(name)) {
+        throw std::runtime_error("Function '" + name + "' is already defined");
+    }
+    Function function;
+    function.node = definition;
+    std::vector<Function> savedFunctions = functions;
+    std::map<std::string, int> savedIndex = functionIndex;
+    auto existing = functionIndex.find(name);
+    if (existing != functionIndex.end()) {
+        // Same index, so calls resolved against the old definition call the new one
+        functions[existing->second] = function;
+    } else {
+        functionIndex[name] = static_cast<int>(functions.size());
+        functions.push_back(function);
+    }
+    // Re-resolving every body binds calls that were made before their
+    // callee existed; on failure the previous definitions are put back
+    try {
+        for (auto& each : functions) {
+            resolveFunction(each);
+        }
+    } catch (...) {
+        functions = std::move(savedFunctions);
+        functionIndex = std::move(savedIndex);
+        for (auto& each : functions) {
+            resolveFunction(each);
+        }
+        throw;
+    }
+}
+
+bool Evaluator::producesValue(ASTNode* node) {
+    if (!isExpression(node)) {
+        return false;
+    }
+    if (node->type != FUNCTION_CALL_NODE) {
+        return true;
+    }
+    if (node->slot < 0) {
+        return node->value == "len";
+    }
+    return anyNode(functions[node->slot].node->children.back(), [](ASTNode* n) {
+        return n->type == RETURN_NODE && !n->children.empty();
+    });
+}
+
+bool Evaluator::runStatements(const std::vector<ASTNode*>& statements, Value& result) {
+    // Resolved against a copy so a chunk with an undefined name declares nothing
+    Scope scope = sessionScope;
+    for (auto statement : statements) {
+        resolve(statement, scope);
+    }
+    sessionScope = std::move(scope);
+    if (frames.empty()) {
+        frames.emplace_back();
+    }
+    Frame& session = frames.front();
+    session.locals.resize(sessionScope.locals.size());
+    session.arrays.resize(sessionScope.arrays.size());
+    session.returned = false;
+    
+    bool keepLast = !statements.empty() && producesValue(statements.back());
+    try {
+        for (size_t i = statements.size(); i > 0; i--) {
+            if (i == statements.size() && keepLast) {
+                push(statements[i - 1]);
+            } else {
+                pushStatement(statements[i - 1]);
+            }
+        }
+        run(0);
+    } catch (...) {
+        tasks.clear();
+        values.clear();
+        frames.resize(1);
+        frames.front().returned = false;
+        throw;
+    }
+    // A top-level return ends the chunk early, before the last statement ran
+    bool hasResult = keepLast && !frames.front().returned && !values.empty();
+    if (hasResult) {
+        result = std::move(values.back());
+    }
+    values.clear();
+    frames.front().returned = false;
+    return hasResult;
+}
+
+void Evaluator::resetSession() {
+    functions.clear();
+    functionIndex.clear();
+    countedLoops.clear();
+    sessionScope = Scope();
+    tasks.clear();
+    values.clear();
+    frames.clear();
+}
+
+std::string Evaluator::generateCppCode(ASTNode* node) {
+    std::stringstream prototypes;
+    std::stringstream definitions;
+    std::stringstream body;
+    usesArrays = false;
+    stringExpressions.clear();
+    
+    if (node->type == PROGRAM_NODE) {
+        for (auto func : node->children) {
+            // Each function gets its own view of declared strings and arrays
+            stringVariables.clear();
+            arraySizes.clear();
+            
+            if (func->type == FUNCTION_DEF_NODE) {
+                std::string signature = "int " + func->value + "(";
+                for (size_t i = 0; i + 1 < func->children.size(); i++) {
+                    signature += (i > 0 ? ", int " : "int ") + func->children[i]->value;
+                }
+                signature += ")";
+                
+                inMainFunction = false;
+                std::string bodyCode = generateStatementCode(func->children.back(), "");
+                bodyCode.insert(bodyCode.size() - 1, "    return 0;\n");
+                prototypes << signature << ";\n";
+                definitions << signature << " " << bodyCode << "\n\n";
+            } else if (func->type == MAIN_FUNCTION_NODE) {
+                inMainFunction = true;
+                for (auto child : func->children) {
+                    body << "    " << generateStatementCode(child) << "\n";
+                }
+            }
+        }
+    }
+    
+    std::stringstream cpp;
+    cpp << "#include <iostream>\n";
+    cpp << "#include <string>\n";
+    if (boundsChecks && usesArrays) {
+        cpp << "#include <cstdlib>\n\n";
+        cpp << "static int npav_index(int i, int size) {\n";
+        cpp << "    if (i < 0 || i >= size) {\n";
+        cpp << "        std::cerr << \"Array index out of bounds\" << std::endl;\n";
+        cpp << "        std::exit(1);\n";
+        cpp << "    }\n";
+        cpp << "    return i;\n";
+        cpp << "}\n";
+    }
+    cpp << "\n";
+    if (!definitions.str().empty()) {
+        cpp << prototypes.str() << "\n";
+        cpp << definitions.str();
+    }
+    cpp << "int main() {\n";
+    cpp << body.str();
+    cpp << "    return 0;\n";
+    cpp << "}\n";
+    
+    return cpp.str();
+}
+
+std::string Evaluator::escapeString(const std::string& str) {
+    std::string escaped;
+    for (char ch : str) {
+        switch (ch) {
+            case '\n': escaped += "\\n"; break;
+            case '\t': escaped += "\\t"; break;
+            case '\r': escaped += "\\r"; break;
+            case '\\': escaped += "\\\\"; break;
+            case '"': escaped += "\\\""; break;
+            default: escaped += ch; break;
+        }
+    }
+    return escaped;
+}
+
+bool Evaluator::isStringExpression(ASTNode* node) {
+    switch (node->type) {
+        case STRING_NODE: return true;
+        case VARIABLE_NODE: return stringVariables.count(node->value) > 0;
+        case ARITHMETIC_NODE: if (node->value == "+") break; return false;
+        default: return false;
+    }
+    // Only nested `+` chains need the cache
+    ASTNode* left = node->children[0];
+    ASTNode* right = node->children[1];
+    auto isPlus = [](ASTNode* operand) { return operand->type == ARITHMETIC_NODE && operand->value == "+"; };
+    if (!isPlus(left) && !isPlus(right)) {
+        return isStringExpression(left) || isStringExpression(right);
+    }
+    auto known = stringExpressions.find(node);
+    if (known != stringExpressions.end()) {
+        return known->second;
+    }
+    // Post-order over the part of the subtree not seen yet, so the operands'
+    // answers are cached before the `+` nodes that combine them
+    std::vector<std::pair<ASTNode*, bool>> pending{{node, false}};
+    while (!pending.empty()) {
+        auto [current, operandsDone] = pending.back();
+        pending.pop_back();
+        if (stringExpressions.count(current)) continue;
+        bool isString = false;
+        switch (current->type) {
+            case STRING_NODE: isString = true; break;
+            case VARIABLE_NODE: isString = stringVariables.count(current->value) > 0; break;
+            case ARITHMETIC_NODE:
+                if (current->value != "+") break;
+                if (!operandsDone) {
+                    pending.push_back({current, true});
+                    pending.push_back({current->children[1], false});
+                    pending.push_back({current->children[0], false});
+                    continue;
+                }
+                isString = stringExpressions[current->children[0]] || stringExpressions[current->children[1]];
+                break;
+            default: break;
+        }
+        stringExpressions[current] = isString;
+    }
+    return stringExpressions[node];
+}
+
+void Evaluator::emitElement(ASTNode* node, ASTNode* indexNode, std::vector<CodePiece>& pieces) {
+    if (!boundsChecks) {
+        pieces.push_back(CodePiece::code(node->value + "["));
+        pieces.push_back(CodePiece::expression(indexNode));
+        pieces.push_back(CodePiece::code("]"));
+        return;
+    }
+    pieces.push_back(CodePiece::code(node->value + "[npav_index("));
+    pieces.push_back(CodePiece::expression(indexNode));
+    pieces.push_back(CodePiece::code(", " + std::to_string(arraySizes[node->value]) + ")]"));
+}
+
+void Evaluator::emitStatement(ASTNode* node, const std::string& indent, std::vector<CodePiece>& pieces) {
+    switch (node->type) {
+        case BLOCK_NODE: {
+            std::string inner = indent + "    ";
+            pieces.push_back(CodePiece::code("{\n"));
+            for (auto child : node->children) {
+                pieces.push_back(CodePiece::code(inner));
+                pieces.push_back(CodePiece::statement(child, inner));
+                pieces.push_back(CodePiece::code("\n"));
+            }
+            pieces.push_back(CodePiece::code(indent + "}"));
+            return;
+        }
+        
+        case IF_NODE: {
+            pieces.push_back(CodePiece::code("if ("));
+            pieces.push_back(CodePiece::expression(node->children[0]));
+            pieces.push_back(CodePiece::code(") "));
+            pieces.push_back(CodePiece::statement(node->children[1], indent));
+            if (node->children.size() > 2) {
+                pieces.push_back(CodePiece::code(" else "));
+                pieces.push_back(CodePiece::statement(node->children[2], indent));
+            }
+            return;
+        }
+        
+        case WHILE_NODE: {
+            pieces.push_back(CodePiece::code("while ("));
+            pieces.push_back(CodePiece::expression(node->children[0]));
+            pieces.push_back(CodePiece::code(") "));
+            pieces.push_back(CodePiece::statement(node->children[1], indent));
+            return;
+        }
+        
+        case FOR_NODE: {
+            pieces.push_back(CodePiece::code("for ("));
+            pieces.push_back(CodePiece::forClause(node->children[0], indent));
+            pieces.push_back(CodePiece::code("; "));
+            pieces.push_back(CodePiece::expression(node->children[1]));
+            pieces.push_back(CodePiece::code("; "));
+            pieces.push_back(CodePiece::forClause(node->children[2], indent));
+            pieces.push_back(CodePiece::code(") "));
+            pieces.push_back(CodePiece::statement(node->children[3], indent));
+            return;
+        }
+        
+        case VARIABLE_DECL_NODE: {
+            pieces.push_back(CodePiece::code("int " + node->value));
+            if (!node->children.empty()) {
+                pieces.push_back(CodePiece::code(" = "));
+                pieces.push_back(CodePiece::expression(node->children[0]));
+            }
+            pieces.push_back(CodePiece::code(";"));
+            return;
+        }
+        
+        case ARRAY_DECL_NODE: {
+            usesArrays = true;
+            arraySizes[node->value] = std::stoi(node->children[0]->value);
+            pieces.push_back(CodePiece::code("int " + node->value + "[" + node->children[0]->value + "] = {};"));
+            return;
+        }
+        
+        case ARRAY_ASSIGN_NODE: {
+            emitElement(node, node->children[0], pieces);
+            pieces.push_back(CodePiece::code(" = "));
+            pieces.push_back(CodePiece::expression(node->children[1]));
+            pieces.push_back(CodePiece::code(";"));
+            return;
+        }
+        
+        case STRING_DECL_NODE: {
+            stringVariables.insert(node->value);
+            pieces.push_back(CodePiece::code("std::string " + node->value));
+            if (!node->children.empty()) {
+                pieces.push_back(CodePiece::code(" = "));
+                pieces.push_back(CodePiece::stringOperand(node->children[0]));
+            }
+            pieces.push_back(CodePiece::code(";"));
+            return;
+        }
+        
+        case ASSIGNMENT_NODE: {
+            pieces.push_back(CodePiece::code(node->value + " = "));
+            pieces.push_back(CodePiece::expression(node->children[0]));
+            pieces.push_back(CodePiece::code(";"));
+            return;
+        }
+        
+        case RETURN_NODE: {
+            if (inMainFunction || node->children.empty()) {
+                pieces.push_back(CodePiece::code("return 0;"));
+                return;
+            }
+            pieces.push_back(CodePiece::code("return "));
+            pieces.push_back(CodePiece::expression(node->children[0]));
+            pieces.push_back(CodePiece::code(";"));
+            return;
+        }
+        
+        default: {
+            // Expression statements, print() included
+            pieces.push_back(CodePiece::expression(node));
+            pieces.push_back(CodePiece::code(";"));
+            return;
+        }
+    }
+}
+
+void Evaluator::emitExpression(ASTNode* node, std::vector<CodePiece>& pieces) {
+    // Names and numbers never get here, CodePiece::expression() turns them into text
+    switch (node->type) {
+        case STRING_NODE: {
+            pieces.push_back(CodePiece::code("\"" + escapeString(node->value) + "\""));
+            return;
+        }
+        
+        case INDEX_NODE: {
+            emitElement(node, node->children[0], pieces);
+            return;
+        }
+        
+        case ARITHMETIC_NODE:
+        case COMPARISON_NODE: {
+            bool strings = node->type == ARITHMETIC_NODE
+                ? isStringExpression(node)
+                : isStringExpression(node->children[0]) && isStringExpression(node->children[1]);
+            if (strings) {
+                pieces.push_back(CodePiece::code("("));
+                pieces.push_back(CodePiece::stringOperand(node->children[0]));
+                pieces.push_back(CodePiece::code(" " + node->value + " "));
+                pieces.push_back(CodePiece::stringOperand(node->children[1]));
+                pieces.push_back(CodePiece::code(")"));
+                return;
+            }
+            [[fallthrough]];
+        }
+        
+        case LOGICAL_NODE: {
+            pieces.push_back(CodePiece::code("("));
+            pieces.push_back(CodePiece::expression(node->children[0]));
+            pieces.push_back(CodePiece::code(" " + node->value + " "));
+            pieces.push_back(CodePiece::expression(node->children[1]));
+            pieces.push_back(CodePiece::code(")"));
+            return;
+        }
+        
+        case UNARY_NODE: {
+            pieces.push_back(CodePiece::code("(" + node->value));
+            pieces.push_back(CodePiece::expression(node->children[0]));
+            pieces.push_back(CodePiece::code(")"));
+            return;
+        }
+        
+        case FUNCTION_CALL_NODE: {
+            if (node->value == "print") {
+                pieces.push_back(CodePiece::code("std::cout << "));
+                pieces.push_back(CodePiece::expression(node->children[0]));
+                return;
+            }
+            if (node->value == "len") {
+                pieces.push_back(CodePiece::code("static_cast<int>("));
+                pieces.push_back(CodePiece::stringOperand(node->children[0]));
+                pieces.push_back(CodePiece::code(".length())"));
+                return;
+            }
+            pieces.push_back(CodePiece::code(node->value + "("));
+            for (size_t i = 0; i < node->children.size(); i++) {
+                if (i > 0) pieces.push_back(CodePiece::code(", "));
+                pieces.push_back(CodePiece::expression(node->children[i]));
+            }
+            pieces.push_back(CodePiece::code(")"));
+            return;
+        }
+        
+        default: {
+            pieces.push_back(CodePiece::code("0"));
+            return;
+        }
+    }
+}
+
+void Evaluator::emitCode(CodePiece piece, std::string& code) {
+    std::vector<CodePiece>& pending = codeStack;
+    std::vector<CodePiece>& expanded = codeExpansion;
+    pending.clear();
+    pending.push_back(std::move(piece));
+    while (!pending.empty()) {
+        CodePiece current = std::move(pending.back());
+        pending.pop_back();
+        expanded.clear();
+        switch (current.kind) {
+            case CodePiece::TEXT:
+                code += current.text;
+                continue;
+            case CodePiece::STATEMENT:
+                emitStatement(current.node, current.text, expanded);
+                break;
+            case CodePiece::FOR_CLAUSE:
+                if (current.node->type == BLOCK_NODE && current.node->children.empty()) continue;
+                emitStatement(current.node, current.text, expanded);
+                if (expanded.back().kind == CodePiece::TEXT && !expanded.back().text.empty() &&
+                    expanded.back().text.back() == ';') {
+                    expanded.back().text.pop_back();
+                }
+                break;
+            case CodePiece::EXPRESSION:
+                emitExpression(current.node, expanded);
+                break;
+            case CodePiece::STRING_OPERAND:
+                expanded.push_back(CodePiece::code(isStringExpression(current.node) ? "std::string(" : "std::to_string("));
+                expanded.push_back(CodePiece::expression(current.node));
+                expanded.push_back(CodePiece::code(")"));
+                break;
+        }
+        // Leading text goes straight out; the rest is pushed reversed, so the
+        // first piece comes off the stack first
+        size_t first = 0;
+        while (first < expanded.size() && expanded[first].kind == CodePiece::TEXT) {
+            code += expanded[first++].text;
+        }
+        for (size_t i = expanded.size(); i > first; i--) {
+            pending.push_back(std::move(expanded[i - 1]));
+        }
+    }
+}
+
+std::string Evaluator::generateStatementCode(ASTNode* node, const std::string& indent) {
+    std::string code;
+    emitCode(CodePiece::statement(node, indent), code);
+    return code;
+}
+
+std::string Evaluator::generateExpressionCode(ASTNode* node) {
+    std::string code;
+    emitCode(CodePiece::expression(node), code);
+    return code;
+}
+
+TimeReport::Phase::Phase(TimeReport* report, const std::string& name, bool subprocess)
+    : report(report), name(name), subprocess(subprocess) {
+    if (!report) return;
+    if (report->phaseStarted) report->phaseStarted(name);
+    if (report->resetPeak) report->resetPeak();
+    bytesStart = report->currentBytes ? report->currentBytes() : 0;
+    cpuStart = subprocess ? childCpuSeconds() : processCpuSeconds();
+    wallStart = std::chrono::steady_clock::now();
+}
+
+TimeReport::Phase::~Phase() {
+    if (!report) return;
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    double cpu = (subprocess ? childCpuSeconds() : processCpuSeconds()) - cpuStart;
+    long long peak = report->peakBytes ? std::max(0LL, report->peakBytes() - bytesStart) : -1;
+    report->phases.push_back({name, wall, cpu, peak});
+    if (report->phaseFinished) report->phaseFinished(report->phases.back());
+}
+
+size_t TimeReport::countNodes(ASTNode* root) {
+    size_t count = 0;
+    std::vector<ASTNode*> pending{root};
+    while (!pending.empty()) {
+        ASTNode* node = pending.back();
+        pending.pop_back();
+        if (!node) continue;
+        count++;
+        pending.insert(pending.end(), node->children.begin(), node->children.end());
+    }
+    return count;
+}
+
+double TimeReport::processCpuSeconds() {
+    return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+}
+
+// User + system time of waited-for children (only available on POSIX)
+double TimeReport::childCpuSeconds() {
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_CHILDREN, &usage) == 0) {
+        return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+               (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+    }
+#endif
+    return 0;
+}
+
+void TimeReport::print(const std::string& filename, std::ostream& out, bool json) const {
+    double totalWall = 0;
+    double totalCpu = 0;
+    for (const auto& phase : phases) {
+        totalWall += phase.wallSeconds;
+        totalCpu += phase.cpuSeconds;
+    }
+    
+    char line[160];
+    if (json) {
+        std::string name;
+        for (char c : filename) {
+            if (c == '"' || c == '\\') name += '\\';
+            name += c;
+        }
+        out << "{\"file\": \"" << name << "\", \"tokens\": " << tokens << ", \"nodes\": " << nodes
+            << ", \"phases\": [";
+        for (size_t i = 0; i < phases.size(); i++) {
+            const auto& phase = phases[i];
+            snprintf(line, sizeof(line), "%s{\"name\": \"%s\", \"wall_ms\": %.3f, \"cpu_ms\": %.3f, \"peak_bytes\": %lld}",
+                     i ? ", " : "", phase.name.c_str(), phase.wallSeconds * 1e3, phase.cpuSeconds * 1e3,
+                     phase.peakBytes);
+            out << line;
+        }
+        snprintf(line, sizeof(line), "], \"total_wall_ms\": %.3f, \"total_cpu_ms\": %.3f}", totalWall * 1e3,
+                 totalCpu * 1e3);
+        out << line << std::endl;
+        return;
+    }
+    
+    out << "Time report for " << filename << " (" << tokens << " tokens, " << nodes << " AST nodes):" << std::endl;
+    snprintf(line, sizeof(line), "  %-10s %12s %12s %14s", "phase", "wall ms", "cpu ms", "peak heap KB");
+    out << line << std::endl;
+    for (const auto& phase : phases) {
+        if (phase.peakBytes >= 0) {
+            snprintf(line, sizeof(line), "  %-10s %12.3f %12.3f %14.1f", phase.name.c_str(),
+                     phase.wallSeconds * 1e3, phase.cpuSeconds * 1e3, phase.peakBytes / 1024.0);
+        } else {
+            snprintf(line, sizeof(line), "  %-10s %12.3f %12.3f %14s", phase.name.c_str(),
+                     phase.wallSeconds * 1e3, phase.cpuSeconds * 1e3, "-");
+        }
+        out << line << std::endl;
+    }
+    snprintf(line, sizeof(line), "  %-10s %12.3f %12.3f", "total", totalWall * 1e3, totalCpu * 1e3);
+    out << line << std::endl;
+}
+
+void ExecutionProfile::print(const std::string& source, std::ostream& out, size_t maxLines) const {
+    std::vector<std::string> text{""};
+    std::istringstream reader(source);
+    std::string sourceLine;
+    while (std::getline(reader, sourceLine)) {
+        size_t first = sourceLine.find_first_not_of(" \t");
+        sourceLine = first == std::string::npos ? "" : sourceLine.substr(first);
+        if (sourceLine.length() > 48) sourceLine = sourceLine.substr(0, 45) + "...";
+        text.push_back(sourceLine);
+    }
+    
+    std::vector<int> order;
+    for (size_t line = 1; line < lines.size(); line++) {
+        if (lines[line].executions > 0 || lines[line].totalSeconds > 0) order.push_back(static_cast<int>(line));
+    }
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        if (lines[a].selfSeconds != lines[b].selfSeconds) return lines[a].selfSeconds > lines[b].selfSeconds;
+        return lines[a].executions > lines[b].executions;
+    });
+    if (order.size() > maxLines) order.resize(maxLines);
+    
+    char row[200];
+    snprintf(row, sizeof(row), "Profile: %lld samples over %.3f s (every %.3f ms)", samples, sampledSeconds,
+             std::chrono::duration<double, std::milli>(interval).count());
+    out << row << std::endl;
+    snprintf(row, sizeof(row), "  %6s %14s %8s %8s  %s", "line", "executions", "self", "total", "source");
+    out << row << std::endl;
+    double scale = sampledSeconds > 0 ? 100.0 / sampledSeconds : 0;
+    for (int line : order) {
+        const LineStats& stats = lines[line];
+        snprintf(row, sizeof(row), "  %6d %14lld %7.1f%% %7.1f%%  %s", line, stats.executions,
+                 stats.selfSeconds * scale, stats.totalSeconds * scale,
+                 static_cast<size_t>(line) < text.size() ? text[line].c_str() : "");
+        out << row << std::endl;
+    }
+}
+
+void ExecutionProfile::writeFolded(std::ostream& out) const {
+    for (const auto& [stack, seconds] : stacks) {
+        out << stack << " " << static_cast<long long>(seconds * 1e6 + 0.5) << "\n";
+    }
+}
+
+void reportSyntaxErrors(const std::string& filename, const SyntaxError& error, std::ostream& errors) {
+    for (const auto& diagnostic : error.diagnostics) {
+        errors << filename << ":" << diagnostic.line << ":" << diagnostic.column 
+               << ": error: " << diagnostic.message << std::endl;
+    }
+    errors << error.diagnostics.size() << " syntax error(s)" << std::endl;
+}
+
+int runProgram(const std::string& filename, const std::string& sourceCode, const RunOptions& options,
+               std::ostream& out, std::ostream& errors) {
+    TimeReport* report = options.timeReport;
+    ASTNode* ast = nullptr;
+    try {
+        std::vector<Token> tokens;
+        {
+            TimeReport::Phase phase(report, "lex");
+            Lexer lexer(sourceCode, out);
+            tokens = lexer.tokenize();
+        }
+        {
+            TimeReport::Phase phase(report, "parse");
+            Parser parser(tokens);
+            ast = parser.parse();
+        }
+        if (report) {
+            report->tokens = tokens.size();
+            report->nodes = TimeReport::countNodes(ast);
+        }
+    } catch (const SyntaxError& e) {
+        reportSyntaxErrors(filename, e, errors);
+        return 1;
+    } catch (const std::exception& e) {
+        out.flush();
+        errors << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return runTree(ast, options, out, errors);
+}
+
+int runTree(ASTNode* ast, const RunOptions& options, std::ostream& out, std::ostream& errors) {
+    TimeReport* report = options.timeReport;
+    try {
+        {
+            TimeReport::Phase phase(report, "optimize");
+            Optimizer optimizer;
+            optimizer.optimize(ast);
+        }
+        {
+            TimeReport::Phase phase(report, "evaluate");
+            Evaluator evaluator;
+            evaluator.setBoundsChecks(options.boundsChecks);
+            evaluator.setStackLimits(options.maxStack, options.maxDepth);
+            evaluator.setOutput(out, errors);
+            evaluator.setProfile(options.profile);
+            evaluator.setCancelFlag(options.cancel);
+            evaluator.setCompileCache(options.compileCache);
+            evaluator.evaluate(ast);
+        }
+        
+        TimeReport::Phase phase(report, "free");
+        delete ast;
+    } catch (const std::exception& e) {
+        delete ast;
+        out.flush();
+        errors << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    out.flush();
+    return 0;
+}
+
+int compileProgram(const std::string& filename, const std::string& sourceCode, std::string outputName,
+                   const RunOptions& options, std::ostream& out, std::ostream& errors) {
+    TimeReport* report = options.timeReport;
+    ASTNode* ast;
+    try {
+        std::vector<Token> tokens;
+        {
+            TimeReport::Phase phase(report, "lex");
+            Lexer lexer(sourceCode, out);
+            tokens = lexer.tokenize();
+        }
+        {
+            TimeReport::Phase phase(report, "parse");
+            Parser parser(tokens);
+            ast = parser.parse();
+        }
+        if (report) {
+            report->tokens = tokens.size();
+            report->nodes = TimeReport::countNodes(ast);
+        }
+    } catch (const SyntaxError& e) {
+        reportSyntaxErrors(filename, e, errors);
+        return 1;
+    } catch (const std::exception& e) {
+        errors << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return compileTree(filename, ast, outputName, options, out, errors);
+}
+
+// Runs a shell command with its stdout and stderr sent to output rather than
+// to this process's own, so a GUI running the compiler in-process still shows
+// g++'s diagnostics. Returns the exit status as system() does.
+static int runCommand(const std::string& command, std::ostream& output) {
+#ifdef _WIN32
+    FILE* pipe = _popen((command + " 2>&1").c_str(), "r");
+#else
+    FILE* pipe = popen((command + " 2>&1").c_str(), "r");
+#endif
+    if (!pipe) {
+        output << "Error: Could not run " << command << std::endl;
+        return -1;
+    }
+    char buffer[4096];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), pipe)) > 0) {
+        output.write(buffer, static_cast<std::streamsize>(count));
+    }
+    output.flush();
+#ifdef _WIN32
+    return _pclose(pipe);
+#else
+    return pclose(pipe);
+#endif
+}
+
+int compileTree(const std::string& filename, ASTNode* ast, std::string outputName, const RunOptions& options,
+                std::ostream& out, std::ostream& errors, std::string* lastCppCode) {
+    TimeReport* report = options.timeReport;
+    std::string cppCode;
+    try {
+        {
+            TimeReport::Phase phase(report, "optimize");
+            Optimizer optimizer;
+            optimizer.optimize(ast);
+        }
+        {
+            TimeReport::Phase phase(report, "codegen");
+            Evaluator evaluator;
+            evaluator.setBoundsChecks(options.boundsChecks);
+            cppCode = evaluator.generateCppCode(ast);
+        }
+        
+        TimeReport::Phase phase(report, "free");
+        delete ast;
+    } catch (const std::exception& e) {
+        delete ast;
+        errors << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    
+    // Determine output executable name
+    if (outputName.empty()) {
+        outputName = filename;
+        size_t dotPos = outputName.find_last_of('.');
+        if (dotPos != std::string::npos) {
+            outputName = outputName.substr(0, dotPos);
+        }
+        #ifdef _WIN32
+        outputName += ".exe";
+        #endif
+    }
+    
+    if (lastCppCode && *lastCppCode == cppCode && std::filesystem::exists(outputName)) {
+        out << "Generated code unchanged, " << outputName << " is up to date" << std::endl;
+        return 0;
+    }
+    
+    // Create temporary C++ file
+    std::string tempCppFile = filename + ".temp.cpp";
+    std::ofstream outFile(tempCppFile);
+    outFile << cppCode;
+    outFile.close();
+    
+    // Compile with g++
+    // Quoted, since the GUI passes absolute paths and a directory may contain spaces
+    std::string compileCommand = "g++ -std=c++17 -o \"" + outputName + "\" \"" + tempCppFile + "\"";
+    out << "Compiling: " << compileCommand << std::endl;
+    
+    if (options.cancel && options.cancel->load()) {
+        std::remove(tempCppFile.c_str());
+        errors << "Error: Interrupted" << std::endl;
+        return 1;
+    }
+    
+    int result;
+    {
+        TimeReport::Phase phase(report, "g++", true);
+        result = runCommand(compileCommand, errors);
+    }
+    
+    // Clean up temporary file
+    std::remove(tempCppFile.c_str());
+    
+    if (result != 0) {
+        if (lastCppCode) lastCppCode->clear();
+        errors << "Compilation failed!" << std::endl;
+        return 1;
+    }
+    if (lastCppCode) *lastCppCode = std::move(cppCode);
+    out << "Successfully compiled " << filename << " to " << outputName << std::endl;
+    return 0;
+}
+
+std::vector<std::string> compileReferences(ASTNode* program) {
+    std::vector<std::string> files;
+    std::vector<ASTNode*> pending{program};
+    while (!pending.empty()) {
+        ASTNode* node = pending.back();
+        pending.pop_back();
+        if (node->type == FUNCTION_CALL_NODE && node->value == "compile" && node->children.size() == 1 &&
+            node->children[0]->type == STRING_NODE &&
+            std::find(files.begin(), files.end(), node->children[0]->value) == files.end()) {
+            files.push_back(node->children[0]->value);
+        }
+        pending.insert(pending.end(), node->children.begin(), node->children.end());
+    }
+    return files;
+}
+
+bool CompileCache::stamp(const std::string& filename, Stamp& result) {
+    std::error_code error;
+    result.modified = std::filesystem::last_write_time(filename, error);
+    if (error) return false;
+    result.size = std::filesystem::file_size(filename, error);
+    if (error) return false;
+    result.inode = 0;
+#ifndef _WIN32
+    struct stat info;
+    if (::stat(filename.c_str(), &info) != 0) return false;
+    result.inode = static_cast<unsigned long long>(info.st_ino);
+#endif
+    return true;
+}
+
+const std::string* CompileCache::find(const std::string& filename, const Stamp& current) const {
+    auto entry = entries.find(filename);
+    return entry != entries.end() && entry->second.stamp == current ? &entry->second.cppCode : nullptr;
+}
+
+void CompileCache::store(const std::string& filename, const Stamp& readVersion, std::string cppCode) {
+    entries[filename] = Entry{readVersion, std::move(cppCode)};
+}
+
+int WatchedProgram::rebuild(const std::string& source, std::ostream& out, std::ostream& errors) {
+    if (!loaded) {
+        document.setText(source);
+        loaded = true;
+    } else if (source != document.text()) {
+        const std::string& old = document.text();
+        size_t prefix = 0;
+        while (prefix < old.size() && prefix < source.size() && old[prefix] == source[prefix]) {
+            prefix++;
+        }
+        size_t suffix = 0;
+        while (suffix < old.size() - prefix && suffix < source.size() - prefix &&
+               old[old.size() - 1 - suffix] == source[source.size() - 1 - suffix]) {
+            suffix++;
+        }
+        document.applyEdit(prefix, old.size() - suffix, source.substr(prefix, source.size() - prefix - suffix));
+    }
+    
+    if (!document.diagnostics().empty()) {
+        reportSyntaxErrors(filename, SyntaxError(document.diagnostics()), errors);
+        return 1;
+    }
+    ASTNode* program = document.program();
+    bool hasMain = program && std::any_of(program->children.begin(), program->children.end(),
+                                          [](ASTNode* child) { return child->type == MAIN_FUNCTION_NODE; });
+    if (!hasMain) {
+        // Unlexable or without main(): the full pipeline reports it as usual
+        return compile ? compileProgram(filename, source, outputName, options, out, errors)
+                       : runProgram(filename, source, options, out, errors);
+    }
+    
+    // The optimizer rewrites its tree in place, and the document's has to keep matching the text
+    ASTNode* ast = program->copy();
+    if (options.timeReport) {
+        options.timeReport->tokens = document.tokens().size();
+        options.timeReport->nodes = TimeReport::countNodes(ast);
+    }
+    return compile ? compileTree(filename, ast, outputName, options, out, errors, &lastCppCode)
+                   : runTree(ast, options, out, errors);
+}
+
+std::vector<std::string> WatchedProgram::references() const {
+    return document.program() ? compileReferences(document.program()) : std::vector<std::string>();
+}
+
+ReplSession::ReplSession(const RunOptions& options) {
+    evaluator.setBoundsChecks(options.boundsChecks);
+    evaluator.setStackLimits(options.maxStack, options.maxDepth);
+    evaluator.setProfile(options.profile);
+    evaluator.setCancelFlag(options.cancel);
+}
+
+bool ReplSession::isComplete(const std::string& input) {
+    LexState state = LEX_CODE;
+    int depth = 0;
+    std::vector<LexSpan> spans;
+    std::istringstream lines(input);
+    std::string line;
+    while (std::getline(lines, line)) {
+        spans.clear();
+        state = Lexer::lexLine(line, state, spans);
+        for (const auto& span : spans) {
+            if (span.type == LPAREN || span.type == LBRACE || span.type == LBRACKET) depth++;
+            if (span.type == RPAREN || span.type == RBRACE || span.type == RBRACKET) depth--;
+        }
+    }
+    return state == LEX_CODE && depth <= 0;
+}
+
+ASTNode* ReplSession::parse(const std::string& input, std::ostream& warnings) {
+    Lexer lexer(input, warnings);
+    std::vector<Token> tokens = lexer.tokenize();
+    bool definitions = tokens[0].type == VOID ||
+        (tokens.size() > 2 && tokens[0].type == INT && tokens[1].type == IDENTIFIER && tokens[2].type == LPAREN);
+    if (definitions) {
+        // parse() would insist on a main(), which a chunk of functions doesn't need
+        Parser parser(tokens);
+        ASTNode* program = parser.parseProgram();
+        if (!parser.getDiagnostics().empty()) {
+            delete program;
+            throw SyntaxError(parser.getDiagnostics());
+        }
+        return program;
+    }
+    
+    // The opening line is a line of its own so diagnostics only shift by one
+    auto parseStatements = [&](const std::string& text) {
+        Lexer wrappedLexer("void main() {\n" + text + "\n}\n", warnings);
+        std::vector<Token> wrapped = wrappedLexer.tokenize();
+        Parser parser(wrapped);
+        return parser.parse();
+    };
+    try {
+        return parseStatements(input);
+    } catch (SyntaxError& e) {
+        size_t last = input.find_last_not_of(" \t\r\n");
+        if (last != std::string::npos && input[last] != ';' && input[last] != '}') {
+            try {
+                return parseStatements(input + ";");
+            } catch (const SyntaxError&) {
+            }
+        }
+        for (auto& diagnostic : e.diagnostics) {
+            diagnostic.line = std::max(1, diagnostic.line - 1);
+        }
+        throw;
+    }
+}
+
+bool ReplSession::execute(const std::string& input, std::ostream& out, std::ostream& errors) {
+    evaluator.setOutput(out, errors);
+    try {
+        if (input.find_first_not_of(" \t\r\n") == std::string::npos) {
+            return true;
+        }
+        // Not optimized: the optimizer inlines calls by name, which would go
+        // stale as soon as the function is redefined in a later chunk
+        ASTNode* chunk = parse(input, errors);
+        chunks.push_back(chunk);
+        std::vector<ASTNode*> statements;
+        for (auto child : chunk->children) {
+            if (child->type == FUNCTION_DEF_NODE) {
+                evaluator.defineFunction(child);
+            } else {
+                statements.insert(statements.end(), child->children.begin(), child->children.end());
+            }
+        }
+        Value result;
+        if (evaluator.runStatements(statements, result)) {
+            if (result.type == Value::STRING) {
+                out << '"' << result.stringValue << '"' << std::endl;
+            } else {
+                out << result.intValue << std::endl;
+            }
+        }
+    } catch (const SyntaxError& e) {
+        out.flush();
+        for (const auto& diagnostic : e.diagnostics) {
+            errors << diagnostic.line << ":" << diagnostic.column << ": error: " << diagnostic.message << std::endl;
+        }
+        return false;
+    } catch (const std::exception& e) {
+        out.flush();
+        errors << "Error: " << e.what() << std::endl;
+        return false;
+    }
+    out.flush();
+    return true;
+}
+
+void ReplSession::reset() {
+    evaluator.resetSession();
+    for (auto chunk : chunks) delete chunk;
+    chunks.clear();
+}
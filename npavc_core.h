@@ -0,0 +1,1048 @@
+// npavc_core.h - lexer, parser, optimizer, evaluator and code generator for
+// the npav language, shared by the npavc command line driver and the GUI
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cctype>
+#include <stdexcept>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <unordered_map>
+#include <set>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <cstdlib>
+#include <filesystem>
+// Token types for our language
+enum TokenType {
+    VOID, MAIN, LPAREN, RPAREN, LBRACE, RBRACE,
+    NUMBER, PLUS, MINUS, MULTIPLY, DIVIDE, MODULO, SEMICOLON,
+    IDENTIFIER, COMMA, STRING, ASSIGN, INT, STRING_TYPE,
+    IF, ELSE, WHILE, FOR, RETURN, LBRACKET, RBRACKET,
+    EQUAL, NOT_EQUAL, LESS_THAN, GREATER_THAN, LESS_THAN_OR_EQUAL, GREATER_THAN_OR_EQUAL,
+    AND, OR, EOF_TOKEN, UNKNOWN
+};
+
+// Token structure
+struct Token {
+    TokenType type;
+    std::string value;
+    int line;
+    int column;
+    size_t start = 0;  // Source offsets [start, end), set by the lexer
+    size_t end = 0;
+    
+    Token(TokenType t, const std::string& v, int l, int c) 
+        : type(t), value(v), line(l), column(c) {}
+};
+
+// How a token type is spelled in error messages
+const char* tokenTypeName(TokenType type);
+
+// A syntax error found by the parser, positioned at the offending token
+struct Diagnostic {
+    int line;
+    int column;
+    std::string message;
+    size_t offset;  // source offset of the token the error was reported at
+};
+
+// Thrown by Parser::parse() after the whole input has been checked;
+// carries every diagnostic found, not just the first
+class SyntaxError : public std::runtime_error {
+public:
+    std::vector<Diagnostic> diagnostics;
+    
+    explicit SyntaxError(const std::vector<Diagnostic>& found)
+        : std::runtime_error(summarize(found)), diagnostics(found) {}
+    
+private:
+    static std::string summarize(const std::vector<Diagnostic>& found);
+};
+
+// What a line leaves open for the next one when lexing line by line
+enum LexState { LEX_CODE, LEX_BLOCK_COMMENT, LEX_STRING };
+
+// A token or comment found by Lexer::lexLine, as offsets [start, end) into the line
+struct LexSpan {
+    size_t start;
+    size_t end;
+    TokenType type;  // UNKNOWN for comments
+    bool comment;
+};
+
+// Lexer class - converts source code into tokens
+class Lexer {
+private:
+    std::string source;
+    std::ostream& warnings;
+    size_t pos;
+    int line;
+    int column;
+    
+    char currentChar() {
+        if (pos >= source.length()) return '\0';
+        return source[pos];
+    }
+    
+    char peekChar() {
+        if (pos + 1 >= source.length()) return '\0';
+        return source[pos + 1];
+    }
+    
+    void advance();
+    
+    void skipWhitespace() {
+        while (isspace(currentChar())) {
+            advance();
+        }
+    }
+    void skipComment();
+
+    Token makeNumber();
+    
+    Token makeString();
+    
+    Token makeIdentifier();
+    
+public:
+    Lexer(const std::string& src, std::ostream& warningStream = std::cout)
+        : source(src), warnings(warningStream), pos(0), line(1), column(1) {}
+    
+    // Lexes the next lexeme into tokens, stamping its source offsets; comments
+    // and unknown characters add nothing. Returns false at end of input.
+    bool lexNext(std::vector<Token>& tokens);
+    
+    Token endOfFile() const {
+        Token eof(EOF_TOKEN, "", line, column);
+        eof.start = eof.end = source.length();
+        return eof;
+    }
+    
+    // Restarts lexing at a known token boundary (used for incremental re-lexing)
+    void seek(size_t offset, int atLine, int atColumn) {
+        pos = offset;
+        line = atLine;
+        column = atColumn;
+    }
+    
+    size_t offset() const { return pos; }
+    int currentLine() const { return line; }
+    int currentColumn() const { return column; }
+    
+    std::vector<Token> tokenize();
+    
+    // Lexes one line on its own, for syntax highlighting. state is what the
+    // previous line left open (a block comment or a string); the return value
+    // is what this one leaves open. Appends a span for each token and comment.
+    static LexState lexLine(const std::string& line, LexState state, std::vector<LexSpan>& spans);
+};
+
+// AST Node types
+enum NodeType {
+    PROGRAM_NODE, MAIN_FUNCTION_NODE, ARITHMETIC_NODE, NUMBER_NODE, 
+    FUNCTION_CALL_NODE, STRING_NODE, VARIABLE_NODE, ASSIGNMENT_NODE,
+    IF_NODE, WHILE_NODE, COMPARISON_NODE, BLOCK_NODE, RETURN_NODE,
+    FUNCTION_DEF_NODE, VARIABLE_DECL_NODE, STRING_DECL_NODE,
+    ARRAY_DECL_NODE, INDEX_NODE, ARRAY_ASSIGN_NODE, FOR_NODE,
+    LOGICAL_NODE, UNARY_NODE
+};
+
+// How a node type is shown when browsing a tree
+const char* nodeTypeName(NodeType type);
+
+// Base AST Node
+struct ASTNode {
+    NodeType type;
+    std::vector<ASTNode*> children;
+    std::string value;
+    int slot = -1;  // Frame slot / function index, filled in by the evaluator's resolver
+    size_t start = 0;  // Source range [start, end) of statements and functions
+    size_t end = 0;
+    int line = 0;      // Where statements and functions start; 0 for expressions
+    int column = 0;
+    
+    ASTNode(NodeType t, const std::string& v = "") : type(t), value(v) {}
+    
+    // Frees the subtree through a worklist: each descendant's children are
+    // detached before it is deleted, so even a million-deep chain never recurses
+    ~ASTNode();
+    
+    // Deep copy of the subtree, source positions included (also without recursion)
+    ASTNode* copy() const;
+};
+
+// Parser class
+//
+// Syntax errors don't abort the parse. The failing statement is recorded as a
+// Diagnostic, the parser skips ahead to a likely statement boundary (panic
+// mode) and carries on, so a single run reports every error it can find.
+class Parser {
+private:
+    static const size_t MAX_DIAGNOSTICS = 100;
+    
+    // Unwinds out of the statement being parsed; caught where statements are parsed
+    struct ParseError : std::runtime_error {
+        int line;
+        int column;
+        size_t offset;
+        ParseError(const Token& at, const std::string& message)
+            : std::runtime_error(message), line(at.line), column(at.column), offset(at.start) {}
+    };
+    
+    // Borrowed, not copied: the token vector must outlive the parser
+    const std::vector<Token>& tokens;
+    size_t pos;
+    std::vector<Diagnostic> diagnostics;
+    
+    const Token& currentToken();
+    
+    void advance() {
+        if (pos < tokens.size()) pos++;
+    }
+    
+    static std::string describe(const Token& token);
+    
+    void expect(TokenType type);
+    
+    void report(const ParseError& error);
+    
+    // Panic mode: skips the rest of a broken statement. Stops after the next
+    // ';' or after a complete {...} group, or before a '}' that closes the
+    // enclosing block.
+    void synchronize();
+    
+    // Parses statements up to the closing '}' (not consumed), recovering
+    // from errors in individual statements
+    void parseStatementsInto(ASTNode* block);
+    
+    // How a token behaves in operator position: its binding strength (0 if it
+    // isn't a binary operator) and the node it builds
+    struct BinaryOperator {
+        int precedence;
+        NodeType node;
+    };
+    
+    static const int UNARY_PRECEDENCE = 7;
+    
+    // Precedence table indexed by TokenType, loosest first, matching C.
+    // All binary operators are left-associative.
+    static const BinaryOperator& binaryOperator(TokenType type);
+    
+    // An entry on the expression parser's operator stack: a pending binary or
+    // prefix operator, or an open '(' group, call argument list or array index
+    struct PendingOperator {
+        enum Kind { BINARY, UNARY, GROUP, CALL, INDEX } kind;
+        Token token;
+        ASTNode* node;  // the call or index node being filled in
+    };
+    
+    // Precedence of the operator on top of the stack, or 0 for an open bracket
+    static int pendingPrecedence(const PendingOperator& op) {
+        if (op.kind == PendingOperator::UNARY) return UNARY_PRECEDENCE;
+        if (op.kind == PendingOperator::BINARY) return binaryOperator(op.token.type).precedence;
+        return 0;
+    }
+    
+    // Expressions are parsed Pratt-style in a single loop over explicit operand
+    // and operator stacks rather than by recursive descent, so arbitrarily long
+    // operator chains and deeply nested parentheses, calls and indices never
+    // grow the C++ stack. Adding an operator only takes a table entry.
+    ASTNode* parseExpression();
+    
+    // Parses `name = expr`, `name[index] = expr` or a bare expression,
+    // without the trailing ';' (shared by statements and for-loop clauses)
+    ASTNode* parseAssignmentOrExpression();
+    
+    // Records the source range covered by tokens [first, pos) and where it starts
+    void setRange(ASTNode* node, size_t first) {
+        node->start = tokens[first].start;
+        node->end = tokens[pos - 1].end;
+        node->line = tokens[first].line;
+        node->column = tokens[first].column;
+    }
+    
+    ASTNode* parseStatement();
+    
+    ASTNode* parseStatementNode();
+    
+    // Parses: int name(int a, int b, ...) { ... }
+    // Children are one VARIABLE_DECL_NODE per parameter followed by the body block
+    ASTNode* parseFunctionDefinition();
+    
+    // Top-level recovery: skips the rest of a broken function, up to and
+    // including its body's closing '}'
+    void synchronizeTopLevel();
+    
+    ASTNode* parseMainFunction();
+    
+public:
+    Parser(const std::vector<Token>& toks) : tokens(toks), pos(0) {}
+    
+    // Everything reported by the last parse
+    const std::vector<Diagnostic>& getDiagnostics() const {
+        return diagnostics;
+    }
+    
+    // Parses the whole token stream, recovering from errors: statements that
+    // fail to parse are left out of the tree and reported in getDiagnostics().
+    // Only throws (SyntaxError) if there are too many errors to continue.
+    ASTNode* parseProgram();
+    
+    // Re-parses the statements in tokens [first, stop) on their own, for
+    // IncrementalDocument. Fails (leaving statements empty) unless they parse
+    // to exactly that range without running into a '}' of an outer block.
+    bool parseStatementRange(size_t first, size_t stop, std::vector<ASTNode*>& statements);
+    
+    // Builds the program's AST. Throws SyntaxError listing every diagnostic if
+    // any statement failed to parse.
+    ASTNode* parse();
+};
+
+// IncrementalDocument - keeps the tokens, AST and diagnostics of one source
+// buffer up to date as it is edited (e.g. from an editor). An edit re-lexes
+// from just before the change until the new tokens line up with the old ones
+// again, then re-parses only the statements it touches in the innermost
+// enclosing block; the rest of the tree is kept and its offsets shifted.
+// Edits outside any block, or that change the block structure, fall back to
+// a full parse.
+class IncrementalDocument {
+private:
+    std::string source;
+    std::vector<Token> tokenList;
+    ASTNode* ast = nullptr;
+    std::vector<Diagnostic> diagnosticList;
+    size_t relexedTokens = 0;
+    size_t reparsedStatements = 0;
+    bool fullReparse = false;
+    // How relex() moved the old tokens it kept: down by lineShift lines, and
+    // across by columnShift if they were on resyncLine
+    int resyncLine = 0;
+    int lineShift = 0;
+    int columnShift = 0;
+    
+    static bool isStatementList(ASTNode* node) {
+        return node->type == BLOCK_NODE || node->type == MAIN_FUNCTION_NODE;
+    }
+    
+    // Statements and functions carry a source range, expressions don't
+    static bool hasRange(ASTNode* node) {
+        return node->end > node->start;
+    }
+    
+    // Moves an offset at or after the end of the replaced text to its new position
+    static size_t shifted(size_t offset, size_t oldEnd, long long delta) {
+        return offset >= oldEnd ? static_cast<size_t>(static_cast<long long>(offset) + delta) : offset;
+    }
+    
+    // Index of the first token starting at or after offset
+    size_t tokenStartingAt(size_t offset) const;
+    
+    // Index of the first token ending at or after offset
+    size_t tokenEndingAt(size_t offset) const;
+    
+    void relexAll();
+    
+    void reparseAll();
+    
+    // Re-lexes the tokens affected by replacing old [start, oldEnd). Lexing
+    // restarts at the token before the first one touching the edit and stops
+    // as soon as a new token matches an old one past the edit; the old tokens
+    // from there on are reused with shifted positions. Sets firstUnchanged to
+    // the index of that first reused token.
+    void relex(size_t start, size_t oldEnd, long long delta, size_t& firstUnchanged);
+    
+    // Re-parses the statements touched by the edit within the innermost block
+    // (or main body) that strictly contains it. Returns false if the edit
+    // can't be handled locally.
+    bool reparse(size_t start, size_t oldEnd, long long delta, size_t firstUnchanged);
+    
+public:
+    explicit IncrementalDocument(const std::string& text = "") {
+        setText(text);
+    }
+    
+    ~IncrementalDocument() {
+        delete ast;
+    }
+    
+    IncrementalDocument(const IncrementalDocument&) = delete;
+    IncrementalDocument& operator=(const IncrementalDocument&) = delete;
+    
+    // Replaces the whole buffer and parses it from scratch
+    void setText(const std::string& text);
+    
+    // Replaces [start, end) of the current text with replacement
+    void applyEdit(size_t start, size_t end, const std::string& replacement);
+    
+    const std::string& text() const { return source; }
+    const std::vector<Token>& tokens() const { return tokenList; }
+    
+    // The current tree. Statements that failed to parse are missing from it.
+    // Null only while the text can't be lexed. Don't run the Optimizer on it
+    // in place - it must keep matching the text.
+    ASTNode* program() const { return ast; }
+    
+    const std::vector<Diagnostic>& diagnostics() const { return diagnosticList; }
+    
+    // What the last setText()/applyEdit() had to redo
+    size_t lastRelexedTokens() const { return relexedTokens; }
+    size_t lastReparsedStatements() const { return reparsedStatements; }
+    bool lastEditWasFullParse() const { return fullReparse; }
+};
+
+// Optimizer - AST rewrites applied after parsing, before evaluation or codegen
+class Optimizer {
+private:
+    static const int MAX_INLINE_NODES = 16;
+    
+    // Functions whose whole body is `return <expr>;`, keyed by name
+    std::map<std::string, ASTNode*> inlineable;
+    
+    // Size of a subtree, counting no further than limit + 1
+    static int countNodes(ASTNode* node, int limit);
+    
+    // The returned expression may only read parameters and must not call anything
+    static bool onlyReadsParams(ASTNode* node, const std::set<std::string>& params);
+    
+    // Arguments are copied into every use of their parameter, so only
+    // side-effect free leaves are allowed
+    static bool isTrivialArgument(ASTNode* node) {
+        return node->type == NUMBER_NODE || node->type == STRING_NODE || node->type == VARIABLE_NODE;
+    }
+    
+    static ASTNode* clone(ASTNode* node);
+    
+    // Copies the function's returned expression with parameters replaced by the call's arguments
+    static ASTNode* substitute(ASTNode* node, ASTNode* funcDef, ASTNode* call);
+    
+    // Replaces an inlineable call in place; its arguments have already been visited
+    void inlineCall(ASTNode*& node);
+    
+    // Post-order walk over the tree with an explicit stack of child slots,
+    // so calls are inlined innermost first without recursing
+    void inlineCalls(ASTNode*& root);
+    
+public:
+    // Inlines calls to small single-expression functions
+    void optimize(ASTNode* program);
+};
+
+// Value type for evaluator
+struct Value {
+    enum Type { INT, STRING } type;
+    int intValue = 0;
+    std::string stringValue;
+    bool uninitWarn = false;
+    Value(int i) : type(INT), intValue(i) {}
+    Value(std::string s) : type(STRING), stringValue(std::move(s)) {}
+
+    Value(ASTNode* n);
+    Value() : type(INT) {}
+};
+
+// Where an interpreted program spends its time, per source line, for
+// `npavc --profile`. Executions are counted exactly: each time a statement
+// starts (a while loop's line once per condition check). Time is sampled:
+// every interval the evaluator charges the time since the last sample to
+// the statement it is running (self) and to every line on the call stack
+// leading to it (total).
+class ExecutionProfile {
+public:
+    struct LineStats {
+        long long executions = 0;
+        double selfSeconds = 0;
+        double totalSeconds = 0;
+    };
+    
+    std::chrono::nanoseconds interval{std::chrono::milliseconds(1)};
+    
+    // Indexed by source line (line 0 is unused)
+    std::vector<LineStats> lines;
+    // Sampled time per call stack, keyed "main:12;fib:4;fib:5": each frame's
+    // function and the line it is running, or the function alone when it is
+    // between statements (just called or returning)
+    std::map<std::string, double> stacks;
+    long long samples = 0;
+    double sampledSeconds = 0;
+    
+    void countExecution(int line) {
+        if (static_cast<size_t>(line) >= lines.size()) lines.resize(line + 1);
+        lines[line].executions++;
+    }
+    
+    // Hottest lines first, with their source text
+    void print(const std::string& source, std::ostream& out, size_t maxLines = 25) const;
+    
+    // One "stack microseconds" line per stack, the input format of
+    // flamegraph.pl and speedscope
+    void writeFolded(std::ostream& out) const;
+};
+
+// Thrown when a run is cancelled through its cancel flag
+struct Interrupted : std::runtime_error {
+    Interrupted() : std::runtime_error("Interrupted") {}
+};
+
+// Evaluator class
+//
+// Programs run on an explicit, heap-allocated work stack rather than the C++
+// call stack. Each Task is a node plus how far along it is; expression results
+// go on a separate value stack and user function calls push a Frame. Deeply
+// nested expressions and deep recursion are bounded by configurable limits
+// (setStackLimits) instead of by the native stack size.
+class CompileCache;
+
+class Evaluator {
+private:
+    static const size_t DEFAULT_MAX_TASKS = 1 << 24;
+    static const size_t DEFAULT_MAX_FRAMES = 1 << 20;
+    
+    // A user-defined function (or main) with the frame layout the resolver gave it
+    struct Function {
+        ASTNode* node = nullptr;
+        size_t paramCount = 0;
+        size_t localCount = 0;
+        size_t arrayCount = 0;
+    };
+    
+    // Locals of one active call, indexed by the slots assigned in resolve()
+    struct Frame {
+        std::vector<Value> locals;
+        std::vector<std::vector<int>> arrays;
+        size_t taskBase = 0;    // work stack height to unwind to on return
+        bool returned = false;
+        ASTNode* function = nullptr;  // definition being run, for the profiler
+    };
+    
+    // Name -> slot maps used while resolving one function body
+    struct Scope {
+        std::map<std::string, int> locals;
+        std::map<std::string, int> arrays;
+    };
+    
+    // One pending unit of work on the explicit stack
+    struct Task {
+        ASTNode* node;
+        int stage;
+        bool discard;       // expression used as a statement - drop its result
+        int* counter;       // counted for loop: the live induction variable
+        int limit;          // counted for loop: the loop-invariant bound
+        int step;
+        TokenType op;
+    };
+    
+    // Stages of a FOR_NODE task
+    enum ForStage {
+        FOR_INIT, FOR_START, FOR_CONDITION, FOR_TEST, FOR_STEP,
+        FOR_COUNTED_TEST, FOR_COUNTED_STEP
+    };
+    
+    std::vector<Function> functions;
+    std::map<std::string, int> functionIndex;
+    std::vector<Frame> frames;
+    std::vector<Task> tasks;
+    std::vector<Value> values;
+    Value returnValue;
+    bool boundsChecks = true;
+    std::ostream* out = &std::cout;
+    std::ostream* errors = &std::cerr;
+    size_t maxTasks = DEFAULT_MAX_TASKS;
+    size_t maxFrames = DEFAULT_MAX_FRAMES;
+    ExecutionProfile* profile = nullptr;
+    const std::atomic<bool>* cancelFlag = nullptr;
+    CompileCache* compileCache = nullptr;
+    
+    // Shape of a for loop that can run as a plain counted loop:
+    // for (...; i op bound; i = i +/- step) where the body never writes i or bound
+    struct CountedLoop {
+        bool counted = false;
+        TokenType op = UNKNOWN;
+        int step = 0;
+    };
+    std::map<ASTNode*, CountedLoop> countedLoops;
+    
+    static bool isBuiltin(const std::string& name) {
+        return name == "printa" || name == "len" || name == "compile";
+    }
+    
+    static bool isExpression(ASTNode* node);
+    
+    // Leaves are read straight from the tree or frame when their parent needs
+    // them, so they never go through the work stack
+    static bool isLeaf(ASTNode* node) {
+        return node->type == VARIABLE_NODE || node->type == NUMBER_NODE || node->type == STRING_NODE;
+    }
+    
+    // True if any node under root satisfies pred (walked without recursion)
+    template <typename Pred>
+    static bool anyNode(ASTNode* root, Pred pred) {
+        std::vector<ASTNode*> pending{root};
+        while (!pending.empty()) {
+            ASTNode* node = pending.back();
+            pending.pop_back();
+            if (pred(node)) return true;
+            pending.insert(pending.end(), node->children.begin(), node->children.end());
+        }
+        return false;
+    }
+    
+    static bool readsVariable(ASTNode* node, const std::string& name) {
+        return anyNode(node, [&](ASTNode* n) {
+            return n->type == VARIABLE_NODE && n->value == name;
+        });
+    }
+    
+    static bool writesVariable(ASTNode* node, const std::string& name);
+    
+    static int declare(std::map<std::string, int>& slots, const std::string& name);
+    
+    // Binds every variable, array and call in a function body to a frame slot
+    // (or function index), so the evaluator never looks names up at runtime.
+    // Walks in source order with an explicit stack; declarations are bound
+    // after their initializer so `int x = x;` still reports x as undefined.
+    void resolve(ASTNode* root, Scope& scope);
+    
+    // Registers every function of the program, then resolves their bodies
+    Function& load(ASTNode* program);
+    
+    // Binds a function's parameters and body to slots and records its frame layout
+    void resolveFunction(Function& function);
+    
+    // Variable slots of an interactive session's main frame, kept between chunks
+    Scope sessionScope;
+    
+    // True for an expression statement worth echoing: not a printa() or a
+    // call to a function that never returns a value
+    bool producesValue(ASTNode* node);
+    
+    static Frame makeFrame(const Function& function);
+    
+    void push(ASTNode* node, bool discard = false);
+    
+    // Statements that are bare expressions still run, but leave no value behind
+    void pushStatement(ASTNode* node) {
+        push(node, isExpression(node));
+    }
+    
+    // Schedules the non-leaf operands children[first, first + count) so that
+    // they run in source order and leave their values on the value stack
+    void pushOperands(ASTNode* node, size_t first, size_t count);
+    
+    static size_t pendingOperands(ASTNode* node, size_t first, size_t count);
+    
+    // Variable reads hand out a reference into the current frame instead of a copy
+    const Value& leafOperand(ASTNode* node, Value& scratch);
+    
+    // Reads the next operand of a node whose non-leaf operands have finished;
+    // cursor walks the value stack from the first of them
+    const Value& operand(ASTNode* child, size_t& cursor, Value& scratch);
+    
+    // Takes ownership of a single finished operand
+    Value popOperand(ASTNode* child);
+    
+    // Completes the current expression task and hands its value to the parent
+    void finish(Value&& result);
+    
+    // Resolves a[i] to its slot in the array's contiguous storage
+    int& element(ASTNode* node, const Value& index);
+    
+    // Appends a value to a string, converting integers to their decimal form
+    static void appendString(std::string& target, const Value& value);
+    
+    // Right-hand operands of `s = s + a + b ...`, last one first
+    static std::vector<ASTNode*> appendPieces(ASTNode* node);
+    
+    // Handles `s = s + a + b ...` on a string variable by appending to its
+    // buffer in place, so building a string in a loop is amortized O(1) per
+    // append instead of copying the whole string every iteration
+    bool scheduleAppend(ASTNode* node);
+    
+    void finishAppend(ASTNode* node);
+    
+    const CountedLoop& analyzeForLoop(ASTNode* node);
+    
+    // Sets up a recognized counted loop to run directly on the induction
+    // variable's storage instead of re-evaluating the condition and step trees
+    bool startCountedLoop(Task& task);
+    
+    static bool countedLoopContinues(const Task& task);
+    
+    static bool isTrue(const Value& condition, const char* error);
+    
+    // Return unwinds the work stack straight back to the call that made this frame
+    void returnFromFrame(Value&& value) {
+        returnValue = std::move(value);
+        frames.back().returned = true;
+        tasks.resize(frames.back().taskBase);
+    }
+    
+    // Moves finished call arguments into the parameter slots of a new frame
+    Frame argumentFrame(ASTNode* call);
+    
+    void checkCall(ASTNode* call);
+    
+    Value compileFile(const std::string& filename);
+    
+    // Runs a builtin once its single argument is ready
+    Value callBuiltin(ASTNode* node, const Value& arg, bool wantResult);
+    
+    Value arithmetic(ASTNode* node, const Value& left, const Value& right);
+    
+    Value comparison(ASTNode* node, const Value& left, const Value& right);
+    
+    // Advances the task on top of the work stack by one stage. Statements
+    // leave the value stack as they found it; expressions add exactly one
+    // value (unless discarded).
+    void step();
+    
+    // Steps between checks of the cancel flag and the profiling clock
+    static const unsigned CHECK_STEPS = 64;
+    // Deeper call stacks keep only their outermost and innermost frames in
+    // a profile sample
+    static const size_t MAX_PROFILE_FRAMES = 256;
+    
+    // Drives the work stack until it drops back to baseDepth
+    void run(size_t baseDepth) {
+        if (profile || cancelFlag) {
+            runChecked(baseDepth);
+            return;
+        }
+        while (tasks.size() > baseDepth) {
+            step();
+        }
+    }
+    
+    // run() that every CHECK_STEPS steps stops if cancelled and, when
+    // profiling, samples the call stack; it also counts executions
+    void runChecked(size_t baseDepth);
+    
+    // Charges elapsed seconds to the statement running in each frame
+    void sampleProfile(double elapsed);
+    
+public:
+    // Array bounds checks can be switched off (--no-bounds-check) for speed
+    void setBoundsChecks(bool enabled) {
+        boundsChecks = enabled;
+    }
+    
+    // Where printa() output and runtime warnings go (stdout / stderr by default)
+    void setOutput(std::ostream& output, std::ostream& errorOutput) {
+        out = &output;
+        errors = &errorOutput;
+    }
+    
+    // Caps the work stack (pending tasks) and the number of active call frames
+    void setStackLimits(size_t taskLimit, size_t frameLimit) {
+        maxTasks = taskLimit;
+        maxFrames = frameLimit;
+    }
+    
+    // Collects an execution profile into target while running (null turns it off)
+    void setProfile(ExecutionProfile* target) {
+        profile = target;
+    }
+    
+    // Makes evaluate() throw Interrupted soon after flag becomes true; the
+    // flag may be set from another thread
+    void setCancelFlag(const std::atomic<bool>* flag) {
+        cancelFlag = flag;
+    }
+    
+    // Lets compile() reuse the C++ of files that haven't changed (null turns it off)
+    void setCompileCache(CompileCache* cache) {
+        compileCache = cache;
+    }
+    
+    // Runs a whole program: loads its functions, then executes main()
+    Value evaluate(ASTNode* node);
+    
+    // Interactive sessions (ReplSession) don't go through evaluate(): they
+    // define functions and run statements one chunk at a time in a main
+    // frame that lives until resetSession(). The nodes must outlive the session.
+    
+    // Adds a function, or replaces the one with the same name
+    void defineFunction(ASTNode* definition);
+    
+    // Runs statements in the session's main frame. Returns true and sets
+    // result if the last one is an expression with a value to show.
+    bool runStatements(const std::vector<ASTNode*>& statements, Value& result);
+    
+    // Forgets every session variable and function
+    void resetSession();
+    
+    std::string generateCppCode(ASTNode* node);
+    private: 
+    // Names declared with `string`, so expressions using them emit std::string code
+    std::set<std::string> stringVariables;
+    // Declared arrays and their sizes, used for the emitted bounds checks
+    std::map<std::string, int> arraySizes;
+    bool usesArrays = false;
+    // main() always exits with 0, whatever its return statements say
+    bool inMainFunction = true;
+    
+    static std::string escapeString(const std::string& str);
+    
+    // Whether each expression node evaluates to a string, worked out once per
+    // node during a generateCppCode() call so nested `+` chains stay linear
+    std::unordered_map<const ASTNode*, bool> stringExpressions;
+    
+    bool isStringExpression(ASTNode* node);
+    
+    // One pending piece of generated code. Like the interpreter, the code
+    // generator works through an explicit stack of these rather than
+    // recursing, so it can translate expressions nested any number of levels.
+    struct CodePiece {
+        enum Kind {
+            TEXT,            // text, as is
+            STATEMENT,       // node as a statement, nested blocks indented past text
+            FOR_CLAUSE,      // init/step clause of a for loop, without the trailing ';'
+            EXPRESSION,      // node as an expression
+            STRING_OPERAND,  // node wrapped to take part in std::string concatenation
+        };
+        Kind kind;
+        ASTNode* node;
+        std::string text;  // TEXT: the text; STATEMENT, FOR_CLAUSE: the indent
+        
+        static CodePiece code(std::string text) { return {TEXT, nullptr, std::move(text)}; }
+        static CodePiece statement(ASTNode* node, std::string indent) { return {STATEMENT, node, std::move(indent)}; }
+        static CodePiece forClause(ASTNode* node, std::string indent) { return {FOR_CLAUSE, node, std::move(indent)}; }
+        static CodePiece expression(ASTNode* node) {
+            // Names and numbers are their own code
+            if (node->type == NUMBER_NODE || node->type == VARIABLE_NODE) return code(node->value);
+            return {EXPRESSION, node, ""};
+        }
+        static CodePiece stringOperand(ASTNode* node) { return {STRING_OPERAND, node, ""}; }
+    };
+    
+    // Work stack of emitCode() and the pieces of the node being expanded,
+    // kept so their storage is reused from one statement to the next
+    std::vector<CodePiece> codeStack;
+    std::vector<CodePiece> codeExpansion;
+    
+    // The pieces of one node, in order, appended to pieces
+    void emitElement(ASTNode* node, ASTNode* indexNode, std::vector<CodePiece>& pieces);
+    
+    void emitStatement(ASTNode* node, const std::string& indent, std::vector<CodePiece>& pieces);
+    
+    void emitExpression(ASTNode* node, std::vector<CodePiece>& pieces);
+    
+    // Expands piece and everything it queues, appending the code to code
+    void emitCode(CodePiece piece, std::string& code);
+    
+    std::string generateStatementCode(ASTNode* node, const std::string& indent = "    ");
+    
+    std::string generateExpressionCode(ASTNode* node);
+};
+
+// Where a run spends its time, for `npavc --time-report`. runProgram() and
+// compileProgram() time each phase they go through when given one; the
+// caller can add its own (e.g. reading the file) with Phase.
+class TimeReport {
+public:
+    struct PhaseTiming {
+        std::string name;
+        double wallSeconds;
+        double cpuSeconds;
+        long long peakBytes;  // heap growth at the phase's high point, -1 if unknown
+    };
+    
+    // Times one phase for as long as it is in scope (safe with a null report).
+    // A subprocess phase is charged the CPU time of the children it waited for.
+    class Phase {
+    public:
+        Phase(TimeReport* report, const std::string& name, bool subprocess = false);
+        ~Phase();
+        Phase(const Phase&) = delete;
+        Phase& operator=(const Phase&) = delete;
+        
+    private:
+        TimeReport* report;
+        std::string name;
+        bool subprocess;
+        std::chrono::steady_clock::time_point wallStart;
+        double cpuStart;
+        long long bytesStart;
+    };
+    
+    std::vector<PhaseTiming> phases;
+    size_t tokens = 0;
+    size_t nodes = 0;
+    
+    // Optional heap probe: bytes currently allocated, and the most allocated
+    // since the last resetPeak. The core doesn't own the allocator, so the
+    // program linking it has to provide these to get peak memory.
+    std::function<long long()> currentBytes;
+    std::function<long long()> peakBytes;
+    std::function<void()> resetPeak;
+    
+    // Optional observers, called on the thread doing the work as each phase
+    // starts and ends (outside the measured time). tokens and nodes are
+    // filled in once parsing is done.
+    std::function<void(const std::string& name)> phaseStarted;
+    std::function<void(const PhaseTiming& timing)> phaseFinished;
+    
+    static size_t countNodes(ASTNode* root);
+    
+    void print(const std::string& filename, std::ostream& out, bool json) const;
+    
+private:
+    static double processCpuSeconds();
+    static double childCpuSeconds();
+};
+
+// The C++ that compile() generated for each file, kept across runs by
+// `npavc --watch` so that files which haven't changed since (same size,
+// modification time and inode) aren't read, lexed, parsed or translated again
+class CompileCache {
+public:
+    // Identifies one version of a file
+    struct Stamp {
+        std::filesystem::file_time_type modified;
+        std::uintmax_t size = 0;
+        unsigned long long inode = 0;
+        
+        bool operator==(const Stamp& other) const {
+            return modified == other.modified && size == other.size && inode == other.inode;
+        }
+    };
+    
+    // False if the file can't be examined
+    static bool stamp(const std::string& filename, Stamp& result);
+    
+    // The C++ stored for filename, if it was stored for this version of it
+    const std::string* find(const std::string& filename, const Stamp& current) const;
+    
+    // Remembers the C++ generated from the version of filename stamped before reading it
+    void store(const std::string& filename, const Stamp& readVersion, std::string cppCode);
+
+private:
+    struct Entry {
+        Stamp stamp;
+        std::string cppCode;
+    };
+    std::map<std::string, Entry> entries;
+};
+
+// Command line options shared by the npavc CLI and in-process runs
+struct RunOptions {
+    bool boundsChecks = true;
+    size_t maxStack = 1 << 24;
+    size_t maxDepth = 1 << 20;
+    TimeReport* timeReport = nullptr;  // filled in per phase when set
+    ExecutionProfile* profile = nullptr;  // collected while interpreting when set
+    const std::atomic<bool>* cancel = nullptr;  // stops the run when it becomes true
+    CompileCache* compileCache = nullptr;  // reused by compile() calls when set
+};
+
+// Prints each syntax error as file:line:column: error: message
+void reportSyntaxErrors(const std::string& filename, const SyntaxError& error, std::ostream& errors);
+
+// Interprets source as `npavc <file>` does: lex, parse, optimize and run it.
+// Program output goes to out, warnings and errors to errors. Returns the
+// exit code the CLI would.
+int runProgram(const std::string& filename, const std::string& sourceCode, const RunOptions& options,
+               std::ostream& out, std::ostream& errors);
+
+// Compiles source to a native executable through g++, as `npavc <file> -c`
+// does. An empty outputName means the source name without its extension.
+int compileProgram(const std::string& filename, const std::string& sourceCode, std::string outputName,
+                   const RunOptions& options, std::ostream& out, std::ostream& errors);
+
+// The second halves of runProgram() and compileProgram(), from optimizing
+// on, for callers that already have the parsed program. Both take ownership
+// of ast. If lastCppCode is given, compileTree() skips g++ when the generated
+// C++ equals it and the executable is still there, and stores the C++ of
+// every successful build in it.
+int runTree(ASTNode* ast, const RunOptions& options, std::ostream& out, std::ostream& errors);
+int compileTree(const std::string& filename, ASTNode* ast, std::string outputName, const RunOptions& options,
+                std::ostream& out, std::ostream& errors, std::string* lastCppCode = nullptr);
+
+// Files named by compile("...") calls in a program
+std::vector<std::string> compileReferences(ASTNode* program);
+
+// WatchedProgram - what `npavc --watch` keeps between rebuilds of a program.
+// The source lives in an IncrementalDocument, and each new version is
+// applied to it as one edit spanning everything between the unchanged prefix
+// and suffix, so only the tokens and statements in that span are lexed and
+// parsed again. Files the program compile()s go through a CompileCache, so
+// only the ones that changed are processed again. For -c builds the last
+// generated C++ is kept too, so g++ (by far the slowest step) only runs when
+// the program actually changed.
+class WatchedProgram {
+private:
+    std::string filename;
+    bool compile;
+    std::string outputName;
+    RunOptions options;
+    IncrementalDocument document;
+    bool loaded = false;
+    std::string lastCppCode;
+    CompileCache compileCache;
+    
+public:
+    WatchedProgram(const std::string& filename, bool compile, const std::string& outputName,
+                   const RunOptions& options)
+        : filename(filename), compile(compile), outputName(outputName), options(options) {
+        this->options.compileCache = &compileCache;
+    }
+    
+    WatchedProgram(const WatchedProgram&) = delete;
+    WatchedProgram& operator=(const WatchedProgram&) = delete;
+    
+    // Brings the program up to date with source, then runs or compiles it.
+    // Returns the exit code runProgram()/compileProgram() would.
+    int rebuild(const std::string& source, std::ostream& out, std::ostream& errors);
+    
+    // compile() targets of the current version, which need watching as well
+    std::vector<std::string> references() const;
+};
+
+// ReplSession - an interpreter that stays alive between inputs, for
+// `npavc --repl` and the GUI console. Each input is a chunk of statements,
+// run in a main() that persists, so its variables keep their values for the
+// next one; or function definitions, which add to (or replace) the session's
+// functions. A whole program may be pasted too: its functions are defined
+// and its main() body runs in the session.
+class ReplSession {
+private:
+    Evaluator evaluator;
+    // Every chunk parsed so far; the evaluator's functions and resolved
+    // slots point into them
+    std::vector<ASTNode*> chunks;
+    
+    // Parses input into a PROGRAM_NODE. Statements are parsed as the body of
+    // a main(); if that fails and the input lacks its final ';', it is retried
+    // with one. Throws SyntaxError with lines relative to the input.
+    static ASTNode* parse(const std::string& input, std::ostream& warnings);
+    
+public:
+    explicit ReplSession(const RunOptions& options = RunOptions());
+    
+    ~ReplSession() {
+        for (auto chunk : chunks) delete chunk;
+    }
+    
+    ReplSession(const ReplSession&) = delete;
+    ReplSession& operator=(const ReplSession&) = delete;
+    
+    // False while input leaves a bracket, block comment or string open, i.e.
+    // more lines are needed before it can run
+    static bool isComplete(const std::string& input);
+    
+    // Parses and runs one chunk. Output goes to out; if the last statement is
+    // an expression, its value is printed there too. Errors go to errors and
+    // make it return false, leaving the session as the chunk's successful
+    // statements left it.
+    bool execute(const std::string& input, std::ostream& out, std::ostream& errors);
+    
+    // Drops every variable and function
+    void reset();
+};